@@ -0,0 +1,58 @@
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+Import("env")
+
+# Builds the filesystem image contents from web/ into data/. Pages, styles and scripts are gzipped, and
+# references between them get their content hash as a query string, so everything but the pages themselves can
+# be cached forever. assets.txt lists each compressed file and the hash the firmware sends as its ETag.
+
+COMPRESS = (".html", ".css", ".js", ".svg", ".ico")
+
+srcDir = os.path.join(env.subst("$PROJECT_DIR"), "web")
+dstDir = env.subst("$PROJECT_DATA_DIR")
+
+def contentHash(data):
+  return hashlib.sha256(data).hexdigest()[:16]
+
+names = sorted(os.listdir(srcDir))
+contents = {}
+for name in names:
+  with open(os.path.join(srcDir, name), "rb") as f:
+    contents[name] = f.read()
+
+# Pages reference the rest, so hash those first
+hashes = {}
+for name in names:
+  if name.endswith(COMPRESS) and not name.endswith(".html"):
+    hashes[name] = contentHash(contents[name])
+
+def versioned(match):
+  name = match.group(2).decode()
+  if name not in hashes: return match.group(0)
+  return match.group(1) + match.group(2) + b"?v=" + hashes[name].encode() + match.group(3)
+
+for name in names:
+  if name.endswith(".html"):
+    contents[name] = re.sub(rb'((?:href|src)=")([^"?#/:]+)(")', versioned, contents[name])
+    hashes[name] = contentHash(contents[name])
+
+if os.path.isdir(dstDir):
+  shutil.rmtree(dstDir)
+os.makedirs(dstDir)
+
+manifest = []
+for name in names:
+  if name in hashes:
+    # mtime of 0 so the output only changes when the content does
+    with open(os.path.join(dstDir, name + ".gz"), "wb") as f:
+      f.write(gzip.compress(contents[name], 9, mtime=0))
+    manifest.append("/" + name + " " + hashes[name] + "\n")
+  else:
+    shutil.copyfile(os.path.join(srcDir, name), os.path.join(dstDir, name))
+
+with open(os.path.join(dstDir, "assets.txt"), "w", newline="") as f:
+  f.writelines(manifest)
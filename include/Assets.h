@@ -0,0 +1,7 @@
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+
+// Serves the gzipped web UI listed in ASSETS_MANIFEST_PATH, with its content hash as a strong ETag so repeat
+// visits are answered with a 304. Anything not listed falls through to the handlers added after this one.
+void assetsInit(AsyncWebServer* server);
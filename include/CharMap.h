@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Print.h>
+
+// Text is laid out one byte per module. ASCII characters are their own byte, and every other character loaded
+// from the character map file gets a byte from 0x80 up, so justification and paging don't need to know about UTF-8.
+
+// Flap shown for each of those bytes
+extern unsigned char charmapFlaps[256];
+
+inline unsigned char charmapFlap(char c) {
+  return charmapFlaps[(unsigned char)c];
+}
+
+// Loads the built-in map, then the map file over it if there is one
+void charmapInit();
+// Same, reporting to out. The built-in map stays if the file doesn't parse.
+bool charmapReload(Print* out);
+// Validates the map at path and swaps it in for the saved one, which is kept if it doesn't parse
+bool charmapReplace(const char* path, Print* out);
+// Back to the built-in map
+void charmapClear();
+// Whether a map file is loaded over the built-in map. Only the master has it, modules map with their own.
+bool charmapCustom();
+// UTF-8 to one byte per character, stops at a null. Returns the number of bytes written.
+unsigned int charmapTranscode(char* dst, unsigned int dstLen, const char* src, unsigned int srcLen);
+// How many bytes of src the first nChars characters charmapTranscode() produces take up
+unsigned int charmapUtf8Bytes(const char* src, unsigned int srcLen, unsigned int nChars);
+// Writes the UTF-8 of the character on a flap (at most 3 bytes, no null) and returns its length, 0 if there's none
+unsigned int charmapFlapToUtf8(unsigned char flap, char* dst);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <time.h>
+
+// Modules can keep a clock going on their own. The master broadcasts the time and time zone every so often, and
+// tells each module which character of which strftime conversion it shows. From then on each module turns to its
+// next digit when the time comes, without the master or the bus.
+
+// Sets the system clock, broadcast by the master with ct
+void clockSetTime(time_t epoch, unsigned int ms);
+// Shows character index of a single strftime conversion, like "%H". Returns false if it isn't one.
+bool clockSetSlot(const char* conversion, unsigned int index);
+// Back to only moving when told to
+void clockStop();
+void clockEvents();
@@ -2,20 +2,58 @@
 
 #include <Stream.h>
 
+#include "Config.h"
+#include "Streams.h"
+
 struct CommandParams; // transparent
 
+enum CommandState {
+  CommandFree,
+  CommandReceiving, // Its text is still arriving
+  CommandQueued,
+  CommandRunning,
+  CommandFinished
+};
+
+// Commands from the web run from loop(), in the order they were queued, each writing to its own output buffer
 struct QueuedCommand {
-  bool queued;
-  bool finished;
+  unsigned long id; // Never reused, so a stale id can't pick up someone else's command
+  CommandState state;
+  bool succeeded;
+  bool released; // Nobody wants the result, free it once it's finished
+  bool attached;
+  const void* owner; // Whoever is sending its text, while it's CommandReceiving
+  unsigned long finishedAt;
   CommandParams* params;
+  // From the pool while the slot is in use. Writes wait for it to be read while a client is streaming it (see
+  // commandAttach()), otherwise what doesn't fit is dropped.
+  PoolMemoryStream* output;
+
+  QueuedCommand();
 };
 
-extern QueuedCommand queuedCommand;
+extern const char* CommandStateStr[];
 
 void printCommandHelp(Print* out);
 
-// Returns the success of the parse and queueing, not the result of the command
-bool handleCommandAsync(char* command, Print* out);
+// Takes a free slot for a command whose text will follow, NULL if there are none, or no memory for its output
+QueuedCommand* commandReserve(const void* owner);
+QueuedCommand* commandFind(unsigned long id);
+QueuedCommand* commandFindOwner(const void* owner);
+// Appends to the text of a command being received, false if it's too long
+bool commandAppend(QueuedCommand* command, const uint8_t* data, size_t len);
+// Parses the text and queues the command. A command that doesn't parse is finished right away, unsuccessfully,
+// with the reason in its output.
+bool commandSubmit(QueuedCommand* command);
+// Whether a client is reading the output as it's written. Attached commands aren't freed when their result
+// times out.
+void commandAttach(QueuedCommand* command, bool attached);
+// Frees the slot, or has it freed when it finishes if it's running. Does nothing if it's already free.
+void commandRelease(QueuedCommand* command);
+// Slots in that state
+unsigned int commandCount(CommandState state);
+// Runs the next queued command, and frees results nobody came back for. Runs from loop().
+void commandEvents();
 
 // Returns whether the command succeeded
 bool handleCommand(char* command, Print* out);
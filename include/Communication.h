@@ -44,6 +44,16 @@ template<typename T> struct ModulePacket {
 
 #pragma pack(pop)
 
+// Transactions the master has made, counting each attempt
+struct I2CStats {
+  unsigned long reads;
+  unsigned long writes;
+  unsigned long retries; // Attempts after the first
+  unsigned long errors; // Reads and writes that failed every attempt
+};
+
+extern I2CStats i2cStats;
+
 extern const char* StatusStr[];
 extern const char* UpdateStatusStr[];
 extern bool i2cOverflow;
@@ -30,6 +30,73 @@
 
 #define DISPLAY_MAX_CHARS 128
 #define DISPLAY_MAX_MODULES 32
+#define DISPLAY_MAX_CELLS (DISPLAY_MAX_MODULES + 1) // Every module, plus the master
+#define DISPLAY_SETTLE_MARGIN 500 // ms on top of a full revolution before reading back where modules landed
+#define DISPLAY_CONFIRM_RETRIES 3
+#define DISPLAY_TRANSITION_STEP 120 // ms between columns in a cascade, or rings in a ripple
+#define DISPLAY_SCROLL_HOLD 200 // ms a scrolling message rests between steps once it has landed
+#define DISPLAY_CLOCK_RESYNC 600 // Seconds between sending modules keeping time the time again
+#define DISPLAY_CLOCK_MAX_SLOTS 31 // Characters of a clock the modules can keep, numbered from 1 below ' '
+#define DISPLAY_UPLOAD_POOL_SIZE 4 // Short messages that can be arriving at once, each needs DISPLAY_MAX_CHARS
+
+#define TIME_NTP_SERVER "pool.ntp.org"
+
+#define MQTT_HOST_SIZE 63
+#define MQTT_CREDENTIAL_SIZE 31
+#define MQTT_TOPIC_SIZE 31
+#define MQTT_RECONNECT_INTERVAL 5000 // ms between attempts to reach the broker
+
+#define FEED_PORT 7777 // UDP port live frames are sent to, see Feed.h
+#define FEED_RESYNC_TIMEOUT 2000 // ms without a frame after which any sequence number starts the stream over
+#define FEED_MAX_DATAGRAMS 4 // Handled per loop(), so a flood can't starve everything else
+
+#define CLOCK_CONVERSION_SIZE 5 // A strftime conversion with a modifier, like "%Ey", plus null
+
+#define PLAYLIST_PATH "/playlist.json"
+#define PLAYLIST_UPLOAD_PATH "/playlist.tmp"
+#define PLAYLIST_MQTT_PATH "/playlist-mqtt.tmp"
+#define PLAYLIST_MAX_ENTRIES 16
+#define PLAYLIST_ENTRY_JSON_SIZE 512
+#define PLAYLIST_CHECK_INTERVAL 5000 // ms between checks for time windows opening or closing
+
+// Messages longer than DISPLAY_MAX_CHARS are kept on the filesystem, and read a page at a time. Uploads go to
+// the upload path, wait at a pending path to be shown, then move to where they're read from.
+#define MESSAGE_MAX_SIZE 65536
+#define MESSAGE_UPLOAD_PATH "/message.tmp"
+#define MESSAGE_PENDING_PATH "/message.new"
+#define MESSAGE_PATH "/message.txt"
+#define MESSAGE_EPHEMERAL_PENDING_PATH "/message-e.new"
+#define MESSAGE_EPHEMERAL_PATH "/message-e.txt"
+
+// Blocks in each size class of the pool that request, command and upload buffers come from (see Pool.h)
+#define POOL_SMALL_SIZE 64
+#define POOL_SMALL_COUNT 8
+#define POOL_MEDIUM_SIZE 192 // A /display upload
+#define POOL_MEDIUM_COUNT 6
+#define POOL_LARGE_SIZE 576 // Command output, or the /status writer
+#define POOL_LARGE_COUNT 6
+
+#define COMMAND_QUEUE_SIZE 4 // Commands from the web that can be queued, running, or waiting to be collected
+#define COMMAND_OUTPUT_SIZE 512
+#define COMMAND_RESULT_TIMEOUT 60000 // ms a finished command's result is kept for a client to collect it
+#define COMMAND_OUTPUT_TIMEOUT 1000 // ms a command's output waits for a client streaming it to make room
+
+#define EVENTS_INTERVAL 100 // ms between looking for changes to push to /events
+#define EVENTS_MAX_WAITING 4 // Messages clients may have queued, on average, before changes are held back
+#define EVENTS_MESSAGE_SIZE 256
+
+#define ASSETS_MANIFEST_PATH "/assets.txt"
+#define ASSETS_MAX 16
+#define ASSETS_MAX_PATH 31
+#define ASSETS_HASH_SIZE 16 // Hex characters of each asset's hash in the manifest
+
+#define CHARMAP_PATH "/charmap.txt"
+#define CHARMAP_UPLOAD_PATH "/charmap.tmp"
+#define CHARMAP_MAX_PAGES 4 // Unicode blocks of 256 characters outside of ASCII the map can draw from
+
+// Special addresses in the grid layout, since neither is a valid I2C device address
+#define DISPLAY_CELL_MASTER 0
+#define DISPLAY_CELL_EMPTY 0xFF
 
 // Helper to concatenate literal strings from defines
 #define DEFTOSTR(x, ...) #x
@@ -66,6 +133,17 @@ struct ModuleConfig {
   char rpm;
   unsigned int multilineDelay;
   char timeZone[CONFIG_TZSIZE+1]; // plus null
+  unsigned char displayRows; // 0 lays out every module in a single row, in enumeration order
+  unsigned char displayCols;
+  unsigned char displayLayout[DISPLAY_MAX_CELLS]; // I2C address shown in each cell, row by row
+  unsigned int minFrameInterval; // ms between applying display messages, newer ones replace those waiting
+  bool distributedClock; // Modules keep time themselves for time messages, see Clock.h
+  unsigned char motionBudget; // Most modules moving at once, to keep within the supply's current. 0 for no limit.
+  char mqttHost[MQTT_HOST_SIZE+1]; // Empty for no MQTT
+  unsigned short mqttPort;
+  char mqttUser[MQTT_CREDENTIAL_SIZE+1];
+  char mqttPassword[MQTT_CREDENTIAL_SIZE+1];
+  char mqttTopic[MQTT_TOPIC_SIZE+1]; // Prefix of every topic
 };
 
 extern ModuleConfig Config;
@@ -7,6 +7,39 @@ enum DisplayJustify {
   JustifyRight
 };
 
+// The order modules start moving in when the display changes
+enum DisplayTransition {
+  TransitionAll, // All at once
+  TransitionCascade, // Column by column, left to right
+  TransitionRipple, // Outwards from the center
+  TransitionSparkle, // Random order
+};
+
+struct DisplayStats {
+  unsigned long messages; // displayMessage() calls
+  unsigned long coalesced; // Messages replaced by a newer one before they were shown
+  unsigned long frames; // Frames that changed at least one module
+};
+
+extern DisplayStats displayStats;
+
 void displayEvents();
-void displayMessage(const char* message, unsigned int len, unsigned int seconds = 0, bool time = false, DisplayJustify justify = JustifyLeft);
-void displaySetTimeZone(const char* timezone);
\ No newline at end of file
+// A scroll of more than 0 runs the message past as a marquee, moving that many characters per step
+void displayMessage(const char* message, unsigned int len, unsigned int seconds = 0, bool time = false, DisplayJustify justify = JustifyLeft, DisplayTransition transition = TransitionAll, unsigned int scroll = 0);
+// Shows a message too long for displayMessage(), which has been written to MESSAGE_UPLOAD_PATH. It's read from
+// there a page at a time, so only needs to fit on the filesystem.
+void displayStoredMessage(unsigned int seconds = 0, DisplayJustify justify = JustifyLeft, DisplayTransition transition = TransitionAll);
+// Shows flaps as they are, one per cell of the layout, row by row. Cells past n are blank.
+void displayFlaps(const unsigned char* flaps, unsigned int n, unsigned int seconds = 0, DisplayTransition transition = TransitionAll);
+void displaySetTimeZone(const char* timezone);
+// What the modules have confirmed they're showing, rows separated by '|'. Cells not (yet) confirmed are '_'.
+unsigned int displayShownText(char* buff, unsigned int buffLen);
+// Whether every module has been sent, and confirmed, its part of the current frame
+bool displaySettled();
+// ms until the current frame is predicted to have landed, 0 once it should have
+unsigned long displayEta();
+// Renders the current message again, for instance after the character map changes
+void displayInvalidate();
+// Rows and columns of 0 go back to a single row of every module. Resets cell assignments to enumeration order.
+bool displaySetLayout(unsigned char rows, unsigned char cols);
+bool displaySetLayoutCell(unsigned char cell, unsigned char addr);
\ No newline at end of file
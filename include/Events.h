@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Communication.h"
+
+class AsyncWebServer;
+
+// Pushes state changes to browsers over server-sent events at /events, and to the MQTT broker if there is one
+// (see Mqtt.h), so they don't need to poll /status. Only the latest state of each thing is kept, and it's held
+// back while a client is behind or the broker is unreachable, so they skip states rather than queueing them.
+
+void eventsInit(AsyncWebServer* server);
+// Sends whatever changed since last time, runs from loop()
+void eventsLoop();
+// Sends the broker everything again, once connected
+void eventsMqttConnected();
+// A module's status, as read back by the display
+void eventsModuleStatus(unsigned char addr, Status status, unsigned char flap);
+// "calibrated" or "stalled", for the master's own motor. Other modules aren't polled, their stalls show up as a
+// change in module status when the display next reads them back, which is after it has moved them.
+void eventsMotor(const char* event);
+void eventsCommandFinished(bool ok);
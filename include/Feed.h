@@ -0,0 +1,33 @@
+#pragma once
+
+// Live frames over UDP, for content that changes often, like a scoreboard. Each datagram is a whole frame:
+//   byte 0     FEED_VERSION
+//   bytes 1-4  Sequence number, big endian. Frames that aren't newer than the last one shown are dropped.
+//   byte 5     Flags, bits 0-1 justify (as DisplayJustify), bit 2 set for flaps, bits 3-4 transition (as
+//              DisplayTransition), the rest 0
+//   the rest   UTF-8 text up to DISPLAY_MAX_CHARS, or with the flaps flag, a flap index per cell of the layout, row
+//              by row, up to DISPLAY_MAX_CELLS
+// Frames go to the display like any other message, so the newest one wins if they come faster than the minimum
+// frame interval. After FEED_RESYNC_TIMEOUT without one, a sender may start again from any sequence number.
+
+#define FEED_VERSION 1
+#define FEED_HEADER_SIZE 6
+
+#define FEED_FLAG_JUSTIFY 0x03
+#define FEED_FLAG_FLAPS 0x04
+#define FEED_FLAG_TRANSITION 0x18
+#define FEED_FLAG_TRANSITION_SHIFT 3
+
+struct FeedStats {
+  unsigned long datagrams; // Everything that arrived on FEED_PORT
+  unsigned long frames; // Datagrams sent on to the display
+  unsigned long outOfOrder; // Frames dropped for not being newer than the last one, including duplicates
+  unsigned long lost; // Sequence numbers skipped over, including those that turn up late
+  unsigned long malformed; // Datagrams that weren't a frame
+};
+
+extern FeedStats feedStats;
+
+void feedInit();
+// Reads what's waiting, without blocking. Runs from loop().
+void feedEvents();
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "Display.h"
+
+// Lays srcBuff out into lines of lineSize characters. Words are wrapped (words longer than a line are split),
+// '|' forces a line break, and every full line is padded with spaces and justified. Doesn't depend on the
+// Arduino core, so it can be built and exercised on the host.
+// Returns the number of characters written to dstBuff (not null terminated), and optionally how many source
+// characters were consumed, so a caller can continue laying out a message from where the last call stopped.
+unsigned int justifyText(char* dstBuff, unsigned int dstBuffLen, const char* srcBuff, unsigned int srcBuffLen, DisplayJustify justify, unsigned int lineSize, size_t* consumed = NULL);
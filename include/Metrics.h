@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Print.h>
+
+// Runtime counters for /metrics, in the Prometheus text format. Most counters live with what they count
+// (displayStats, feedStats, i2cStats, motorStats), these are the ones that don't belong anywhere else.
+
+// Marks the start of a loop() iteration
+void metricsLoop();
+void metricsHttpRequest(unsigned int method);
+// Time spent in a web handler callback, which nothing else can run during
+void metricsHttpHandler(unsigned long micros);
+void metricsWrite(Print* out);
@@ -1,5 +1,12 @@
 #pragma once
 
+struct MotorStats {
+  unsigned long moves;
+  unsigned long stalls;
+};
+
+extern MotorStats motorStats;
+
 void motorInit();
 void motorSetRPM(int rpm);
 void motorCalibrate();
@@ -7,6 +14,7 @@ void disableMotorTimer();
 void enableMotorTimer();
 void motorMoveToFlap(unsigned int flap);
 unsigned int motorCurrentFlap();
+unsigned long motorTravelMillis(unsigned int from, unsigned int to);
 void motorDebugPrint();
 
 extern volatile bool motorCalibrated;
@@ -0,0 +1,17 @@
+#pragma once
+
+// Optional connection to an MQTT broker, set up with the mq and mt commands. With a topic prefix of "splitflap":
+//   splitflap/display   Text to show, as POSTed to /display
+//   splitflap/playlist  A playlist, as POSTed to /playlist, or empty to clear it
+//   splitflap/cmd       A command, its output is published to splitflap/cmd/result
+// Events (see Events.h) are published under the same prefix, those that are state under splitflap/state/, and
+// splitflap/online says whether the wall is connected. Connecting and reconnecting happen in the background, nothing here waits on the network.
+
+void mqttInit();
+// Reconnects if need be, and publishes the results of commands. Runs from loop().
+void mqttEvents();
+// Drops the connection, and reconnects with what's in Config
+void mqttReconfigure();
+bool mqttConnected();
+// Publishes under the topic prefix. Returns false if it couldn't be sent now, which is worth trying again later.
+bool mqttPublish(const char* topic, const char* payload, bool retain);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <Print.h>
+
+// Loads the saved playlist, if there is one
+void playlistInit();
+// Picks the entry to show, runs from displayEvents()
+void playlistEvents();
+// Validates the playlist at path and swaps it in for the saved one, which is kept if it doesn't parse
+bool playlistReplace(const char* path, Print* out);
+void playlistClear();
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+#include <utility>
+
+// Fixed blocks in a few size classes for buffers that come and go with requests and commands, so they can't
+// fragment the heap. A request is served from the smallest class with a free block that fits, and fails when
+// there's none rather than falling back to the heap. Not for use from interrupts.
+
+struct PoolStats {
+  size_t blockSize;
+  unsigned int blocks;
+  unsigned int used;
+  unsigned int highWater; // Most blocks ever used at once
+  unsigned long failures; // Allocations that fit this class, but found it (and every larger one) full
+};
+
+// Returns NULL if there's no free block big enough
+void* poolAlloc(size_t size);
+void poolFree(void* p);
+unsigned int poolClasses();
+PoolStats poolStats(unsigned int sizeClass);
+// Allocations bigger than the largest class
+unsigned long poolOversized();
+
+template<typename T, typename... Args> T* poolNew(Args&&... args) {
+  void* mem = poolAlloc(sizeof(T));
+  return mem ? new (mem) T(std::forward<Args>(args)...) : NULL;
+}
+
+template<typename T> void poolDelete(T* p) {
+  if (!p) return;
+  p->~T();
+  poolFree(p);
+}
+
+// For StreamUtils streams
+struct PoolAllocator {
+  void* allocate(size_t n) {
+    return poolAlloc(n);
+  }
+
+  void deallocate(void* p) {
+    poolFree(p);
+  }
+};
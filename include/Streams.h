@@ -3,6 +3,10 @@
 #include <Arduino.h>
 #include <Stream.h>
 
+#include <StreamUtils/Streams/MemoryStream.hpp>
+
+#include "Pool.h"
+
 class FlashStream : public Stream {
   unsigned int _addrBegin;
   unsigned int _size;
@@ -86,4 +90,6 @@ public:
   }
 
   using T::write;
-};
\ No newline at end of file
+};
+
+typedef BlockingStream<StreamUtils::BasicMemoryStream<PoolAllocator>> PoolMemoryStream;
\ No newline at end of file
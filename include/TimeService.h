@@ -0,0 +1,11 @@
+#pragma once
+
+#include <time.h>
+
+// Starts SNTP whenever WiFi connects, and keeps track of whether the clock has been set since
+void timeInit();
+// Never waits for a sync. Returns false until the first one, leaving timeInfo alone.
+bool timeNow(tm* timeInfo);
+bool timeSynced();
+// ms since the clock was last set by SNTP, 0 if it never was
+unsigned long timeSinceSync();
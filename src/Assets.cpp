@@ -0,0 +1,86 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
+
+#include "Assets.h"
+
+#include "Config.h"
+
+struct Asset {
+  char path[ASSETS_MAX_PATH+1];
+  char etag[ASSETS_HASH_SIZE+3]; // Quoted
+};
+
+class AssetHandler : public AsyncWebHandler {
+public:
+  // Each line of the manifest is a path and its hash, as written by gzipData.py
+  bool load() {
+    File file = LittleFS.open(ASSETS_MANIFEST_PATH, "r");
+    if (!file) return false;
+
+    while (file.available() && _nAssets < ASSETS_MAX) {
+      char line[ASSETS_MAX_PATH + ASSETS_HASH_SIZE + 3];
+      unsigned int len = file.readBytesUntil('\n', line, sizeof(line) - 1);
+      line[len] = '\0';
+
+      char* hash = strchr(line, ' ');
+      if (!hash || hash - line > ASSETS_MAX_PATH || strlen(hash + 1) != ASSETS_HASH_SIZE) continue;
+      *hash++ = '\0';
+
+      Asset& asset = _assets[_nAssets++];
+      strcpy(asset.path, line);
+      snprintf(asset.etag, sizeof(asset.etag), "\"%s\"", hash);
+    }
+    return _nAssets;
+  }
+
+  bool canHandle(AsyncWebServerRequest* request) override {
+    if (request->method() != HTTP_GET || !find(request->url())) return false;
+    request->addInterestingHeader("If-None-Match");
+    return true;
+  }
+
+  void handleRequest(AsyncWebServerRequest* request) override {
+    const Asset* asset = find(request->url());
+    AsyncWebServerResponse* response;
+
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == asset->etag) {
+      response = request->beginResponse(304);
+    } else {
+      // Finds the .gz and sets Content-Encoding itself, the content type comes from the uncompressed name
+      response = request->beginResponse(LittleFS, asset->path, String());
+    }
+
+    response->addHeader("ETag", asset->etag);
+    // Pages are always revalidated, which costs a 304. Everything else is referenced with its hash in the URL, so
+    // a change is a new URL, and can be kept as long as the browser likes.
+    if (strstr(asset->path, ".html")) {
+      response->addHeader("Cache-Control", "no-cache");
+    } else {
+      response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+    }
+    request->send(response);
+  }
+
+private:
+  Asset _assets[ASSETS_MAX];
+  unsigned int _nAssets = 0;
+
+  const Asset* find(const String& url) {
+    const char* path = url == "/" ? "/index.html" : url.c_str();
+    for (unsigned int i = 0; i < _nAssets; i++) {
+      if (!strcmp(_assets[i].path, path)) return &_assets[i];
+    }
+    return NULL;
+  }
+};
+
+void assetsInit(AsyncWebServer* server) {
+  AssetHandler* handler = new AssetHandler();
+  if (!handler->load()) {
+    LOGLN("No asset manifest, serving the filesystem as is");
+    delete handler;
+    return;
+  }
+  server->addHandler(handler);
+}
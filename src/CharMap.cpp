@@ -0,0 +1,259 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "CharMap.h"
+
+#include "Config.h"
+#include "CharFlapMap.h"
+
+#define CHARMAP_FIRST_EXTENDED 0x80
+#define CHARMAP_UNMAPPED 0x7F // Shown blank like DEL, but still takes up a module, unlike a space
+
+unsigned char charmapFlaps[256];
+
+// Codepoint of each byte from CHARMAP_FIRST_EXTENDED up
+static unsigned short extendedCodepoints[256 - CHARMAP_FIRST_EXTENDED];
+static unsigned int nExtended = 0;
+
+// Two level lookup from a (BMP) codepoint to its byte. The high byte of the codepoint picks a page, 1-based so 0
+// means there's none, and the low byte indexes into it, where 0 means unmapped.
+static unsigned char pageSlots[256];
+static unsigned char pages[CHARMAP_MAX_PAGES][256];
+static unsigned int nPages = 0;
+static bool custom = false; // Loaded from the map file, rather than only the built-in map
+
+// First byte shown on each flap, for reading back what the display shows
+static unsigned char flapBytes[MOTOR_FLAPS];
+
+static void loadBuiltin() {
+  // Control characters and anything unmapped show as a space
+  memset(charmapFlaps, CharFlapMap[0], sizeof(charmapFlaps));
+  for (unsigned int c = 32; c < 128; c++) {
+    charmapFlaps[c] = CharFlapMap[c - 32];
+  }
+
+  nExtended = 0;
+  nPages = 0;
+  custom = false;
+  memset(pageSlots, 0, sizeof(pageSlots));
+}
+
+// Upper case comes before lower case, and anything in ASCII before the rest
+static void buildFlapBytes() {
+  memset(flapBytes, 0, sizeof(flapBytes));
+  for (unsigned int c = 32; c < CHARMAP_FIRST_EXTENDED + nExtended; c++) {
+    if (c == CHARMAP_UNMAPPED) continue;
+    if (charmapFlaps[c] < MOTOR_FLAPS && !flapBytes[charmapFlaps[c]]) flapBytes[charmapFlaps[c]] = c;
+  }
+}
+
+// Returns the length of the sequence, invalid ones are a single byte decoding to U+FFFD
+static unsigned int decodeUtf8(const unsigned char* src, unsigned int srcLen, unsigned long* codepoint) {
+  unsigned int len;
+
+  if (src[0] < 0x80) {
+    *codepoint = src[0];
+    return 1;
+  } else if ((src[0] & 0xE0) == 0xC0) {
+    len = 2;
+    *codepoint = src[0] & 0x1F;
+  } else if ((src[0] & 0xF0) == 0xE0) {
+    len = 3;
+    *codepoint = src[0] & 0x0F;
+  } else if ((src[0] & 0xF8) == 0xF0) {
+    len = 4;
+    *codepoint = src[0] & 0x07;
+  } else {
+    *codepoint = 0xFFFD;
+    return 1;
+  }
+
+  if (len > srcLen) {
+    *codepoint = 0xFFFD;
+    return 1;
+  }
+
+  for (unsigned int i = 1; i < len; i++) {
+    if ((src[i] & 0xC0) != 0x80) {
+      *codepoint = 0xFFFD;
+      return 1;
+    }
+    *codepoint = (*codepoint << 6) | (src[i] & 0x3F);
+  }
+  return len;
+}
+
+static unsigned char codepointToByte(unsigned long codepoint) {
+  if (codepoint < 0x80) return codepoint;
+  if (codepoint > 0xFFFF) return CHARMAP_UNMAPPED;
+
+  unsigned char slot = pageSlots[codepoint >> 8];
+  if (!slot) return CHARMAP_UNMAPPED;
+
+  unsigned char c = pages[slot - 1][codepoint & 0xFF];
+  return c ? c : CHARMAP_UNMAPPED;
+}
+
+static bool addMapping(unsigned long codepoint, unsigned int flap, Print* out) {
+  if (flap >= MOTOR_FLAPS) {
+    out->printf("Flap %u out of range 0-%u\n", flap, MOTOR_FLAPS - 1);
+    return false;
+  }
+
+  if (codepoint < 0x80) {
+    charmapFlaps[codepoint] = flap;
+    return true;
+  }
+
+  if (codepoint > 0xFFFF || codepoint == 0xFFFD) {
+    out->print("Only valid characters up to U+FFFF are supported\n");
+    return false;
+  }
+
+  unsigned char c = codepointToByte(codepoint);
+  if (c == CHARMAP_UNMAPPED) {
+    if (nExtended >= sizeof(extendedCodepoints) / sizeof(extendedCodepoints[0])) {
+      out->print("Too many characters outside of ASCII\n");
+      return false;
+    }
+
+    if (!pageSlots[codepoint >> 8]) {
+      if (nPages >= CHARMAP_MAX_PAGES) {
+        out->print("Characters from too many blocks, max " DEFTOLIT(CHARMAP_MAX_PAGES) " blocks of 256\n");
+        return false;
+      }
+      memset(pages[nPages], 0, sizeof(pages[nPages]));
+      pageSlots[codepoint >> 8] = ++nPages;
+    }
+
+    c = CHARMAP_FIRST_EXTENDED + nExtended;
+    extendedCodepoints[nExtended++] = codepoint;
+    pages[pageSlots[codepoint >> 8] - 1][codepoint & 0xFF] = c;
+  }
+
+  charmapFlaps[c] = flap;
+  return true;
+}
+
+// Each line is a character, whitespace, and the flap number it's on, for instance "Ä 27"
+static bool charmapLoad(const char* path, Print* out) {
+  loadBuiltin();
+
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    out->printf("Couldn't open %s\n", path);
+    return false;
+  }
+
+  unsigned int lineNumber = 0;
+  while (file.available()) {
+    char line[32];
+    unsigned int len = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[len] = '\0';
+    lineNumber++;
+
+    if (len && line[len - 1] == '\r') line[--len] = '\0';
+    if (!len) continue;
+
+    unsigned long codepoint;
+    unsigned int charLen = decodeUtf8((const unsigned char*)line, len, &codepoint);
+
+    char* end;
+    unsigned long flap = strtoul(&line[charLen], &end, 10);
+    if (end == &line[charLen] || *end || !isspace(line[charLen]) || !addMapping(codepoint, flap, out)) {
+      out->printf("Line %u of %s is invalid\n", lineNumber, path);
+      loadBuiltin();
+      buildFlapBytes();
+      return false;
+    }
+  }
+
+  buildFlapBytes();
+  custom = true;
+  return true;
+}
+
+void charmapInit() {
+  charmapReload(&Serial);
+}
+
+bool charmapReload(Print* out) {
+  loadBuiltin();
+  buildFlapBytes();
+
+  if (!LittleFS.exists(CHARMAP_PATH)) return true;
+  if (!charmapLoad(CHARMAP_PATH, out)) return false;
+
+  out->printf("Loaded character map with %u characters outside of ASCII\n", nExtended);
+  return true;
+}
+
+bool charmapReplace(const char* path, Print* out) {
+  if (!charmapLoad(path, out)) {
+    LittleFS.remove(path);
+    // Back to the one we had
+    if (LittleFS.exists(CHARMAP_PATH)) charmapLoad(CHARMAP_PATH, out);
+    return false;
+  }
+
+  if (!LittleFS.rename(path, CHARMAP_PATH)) {
+    out->print("Couldn't save character map\n");
+    return false;
+  }
+
+  out->printf("Loaded character map with %u characters outside of ASCII\n", nExtended);
+  return true;
+}
+
+void charmapClear() {
+  LittleFS.remove(CHARMAP_PATH);
+  loadBuiltin();
+  buildFlapBytes();
+}
+
+bool charmapCustom() {
+  return custom;
+}
+
+unsigned int charmapTranscode(char* dst, unsigned int dstLen, const char* src, unsigned int srcLen) {
+  unsigned int srcPos = 0;
+  unsigned int dstPos = 0;
+
+  while (srcPos < srcLen && src[srcPos] && dstPos < dstLen) {
+    unsigned long codepoint;
+    srcPos += decodeUtf8((const unsigned char*)&src[srcPos], srcLen - srcPos, &codepoint);
+    dst[dstPos++] = codepointToByte(codepoint);
+  }
+  return dstPos;
+}
+
+unsigned int charmapUtf8Bytes(const char* src, unsigned int srcLen, unsigned int nChars) {
+  unsigned int srcPos = 0;
+
+  while (nChars-- && srcPos < srcLen && src[srcPos]) {
+    unsigned long codepoint;
+    srcPos += decodeUtf8((const unsigned char*)&src[srcPos], srcLen - srcPos, &codepoint);
+  }
+  return srcPos;
+}
+
+unsigned int charmapFlapToUtf8(unsigned char flap, char* dst) {
+  if (flap >= MOTOR_FLAPS || !flapBytes[flap]) return 0;
+
+  unsigned char c = flapBytes[flap];
+  if (c < CHARMAP_FIRST_EXTENDED) {
+    dst[0] = c;
+    return 1;
+  }
+
+  unsigned long codepoint = extendedCodepoints[c - CHARMAP_FIRST_EXTENDED];
+  if (codepoint < 0x800) {
+    dst[0] = 0xC0 | (codepoint >> 6);
+    dst[1] = 0x80 | (codepoint & 0x3F);
+    return 2;
+  }
+  dst[0] = 0xE0 | (codepoint >> 12);
+  dst[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+  dst[2] = 0x80 | (codepoint & 0x3F);
+  return 3;
+}
@@ -0,0 +1,99 @@
+#include <Arduino.h>
+
+#include <sys/time.h>
+#include <time.h>
+
+#include "CharMap.h"
+#include "Clock.h"
+#include "Motor.h"
+
+#include "Config.h"
+
+// Until the master has sent the time, the clock starts at 1970
+#define CLOCK_TIME_VALID 1577836800 // 2020-01-01
+
+static char slotConversion[CLOCK_CONVERSION_SIZE] = {0};
+static unsigned int slotIndex = 0;
+static time_t lastTick = 0;
+static unsigned int shownFlap = MOTOR_FLAPS;
+
+// The next time the character changes within a revolution, 0 if it doesn't
+static time_t nextChange = 0;
+static unsigned int nextFlap = MOTOR_FLAPS;
+static bool prerolled = false; // Already on its way to nextFlap
+
+void clockSetTime(time_t epoch, unsigned int ms) {
+  timeval tv = { .tv_sec = epoch, .tv_usec = (suseconds_t)ms * 1000 };
+  settimeofday(&tv, NULL);
+  lastTick = 0;
+  prerolled = false;
+}
+
+bool clockSetSlot(const char* conversion, unsigned int index) {
+  if (conversion[0] != '%' || strlen(conversion) >= sizeof(slotConversion) || strchr(conversion + 1, '%')) return false;
+
+  strcpy(slotConversion, conversion);
+  slotIndex = index;
+  lastTick = 0;
+  shownFlap = MOTOR_FLAPS;
+  prerolled = false;
+  return true;
+}
+
+void clockStop() {
+  slotConversion[0] = '\0';
+}
+
+static unsigned int flapAt(time_t when) {
+  tm timeInfo;
+  char buff[32];
+  localtime_r(&when, &timeInfo);
+  unsigned int len = strftime(buff, sizeof(buff), slotConversion, &timeInfo);
+
+  return charmapFlap(slotIndex < len ? buff[slotIndex] : ' ');
+}
+
+static void showFlap(unsigned int flap) {
+  if (flap == shownFlap) return;
+  shownFlap = flap;
+  motorMoveToFlap(flap);
+}
+
+void clockEvents() {
+  if (!slotConversion[0]) return;
+
+  timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < CLOCK_TIME_VALID) return;
+
+  // Nothing can change more often than once a second
+  if (now.tv_sec != lastTick) {
+    lastTick = now.tv_sec;
+
+    unsigned int flap = flapAt(now.tv_sec);
+    if (!prerolled || now.tv_sec >= nextChange) {
+      showFlap(flap);
+      prerolled = false;
+    }
+
+    // Look as far ahead as the flap could take to get anywhere
+    unsigned int lookahead = (motorTravelMillis(MOTOR_FLAPS, 0) + 999) / 1000;
+    nextChange = 0;
+    for (unsigned int s = 1; s <= lookahead; s++) {
+      nextFlap = flapAt(now.tv_sec + s);
+      if (nextFlap != flap) {
+        nextChange = now.tv_sec + s;
+        break;
+      }
+    }
+  }
+
+  // Start early enough to land on the next character as it changes
+  if (nextChange && !prerolled) {
+    long long until = (long long)(nextChange - now.tv_sec) * 1000 - now.tv_usec / 1000;
+    if (until <= (long long)motorTravelMillis(shownFlap, nextFlap)) {
+      showFlap(nextFlap);
+      prerolled = true;
+    }
+  }
+}
@@ -9,9 +9,13 @@
 #include "Config.h"
 
 #include "Commands.h"
+#include "CharMap.h"
+#include "Clock.h"
 #include "Communication.h"
 #include "Motor.h"
+#include "Mqtt.h"
 #include "Display.h"
+#include "Events.h"
 #include "Streams.h"
 #include "Utils.h"
 
@@ -46,8 +50,30 @@ struct CommandParams {
   }
 };
 
-CommandParams queuedParams = {0}; // Storage
-QueuedCommand queuedCommand = { .queued = false, .params = &queuedParams };
+// We store these globally since they're so large, and cause crazy heap fragmentation, and eventual crashes.
+static CommandParams queuedParams[COMMAND_QUEUE_SIZE];
+static QueuedCommand queuedCommands[COMMAND_QUEUE_SIZE];
+static unsigned long lastCommandId = 0;
+
+static_assert(COMMAND_OUTPUT_SIZE <= POOL_LARGE_SIZE, "Command output should fit a large pool block");
+
+const char* CommandStateStr[] = {
+  "FREE",
+  "RECEIVING",
+  "QUEUED",
+  "RUNNING",
+  "FINISHED"
+};
+
+QueuedCommand::QueuedCommand() :
+  id(0), state(CommandFree), succeeded(false), released(false), attached(false), owner(NULL), finishedAt(0),
+  params(&queuedParams[this - queuedCommands]), output(NULL) {}
+
+static void commandFree(QueuedCommand& command) {
+  command.state = CommandFree;
+  poolDelete(command.output);
+  command.output = NULL;
+}
 
 void printCommandHelp(Print* out);
 
@@ -183,10 +209,70 @@ bool moveToFlapCommand(unsigned char nArgs, const char** args, Print* out) {
     return false;
   }
 
+  // Told where to go, so no longer keeping time
+  clockStop();
   motorMoveToFlap(newFlap);
   return true;
 }
 
+bool clockTimeCommand(unsigned char nArgs, const char** args, Print* out) {
+  unsigned int epoch;
+  unsigned int ms;
+
+  if (!argInRange(args[1], 0, UINT_MAX, &epoch) || !argInRange(args[2], 0, 999, &ms)) {
+    out->printf("Failed: Expected seconds since the epoch and ms\n");
+    return false;
+  }
+
+  clockSetTime(epoch, ms);
+  return true;
+}
+
+bool clockZoneCommand(unsigned char nArgs, const char** args, Print* out) {
+  if (nArgs > 1 && strlen(args[1]) > CONFIG_TZSIZE) {
+    out->printf("Failed: Input too long (max" DEFTOLIT(CONFIG_TZSIZE) ")\n");
+    return false;
+  }
+
+  // Not saved, the master sends it along with the time
+  displaySetTimeZone(nArgs > 1 ? args[1] : NULL);
+  return true;
+}
+
+bool clockSlotCommand(unsigned char nArgs, const char** args, Print* out) {
+  unsigned int index;
+
+  if (nArgs == 1) {
+    clockStop();
+    return true;
+  }
+
+  if (!argInRange(args[2], 0, 31, &index) || !clockSetSlot(args[1], index)) {
+    out->printf("Failed: Expected a strftime conversion and a character index 0-31\n");
+    return false;
+  }
+
+  out->printf("Keeping time with character %u of %s\n", index, args[1]);
+  return true;
+}
+
+bool setDistributedClockCommand(unsigned char nArgs, const char** args, Print* out) {
+  int enabled;
+
+  if (!argInRange(args[1], 0, 1, &enabled)) {
+    out->printf("Failed: Takes 1 or 0\n");
+    return false;
+  }
+
+  out->printf("Modules %s keep time themselves\n", enabled ? "now" : "no longer");
+
+  Config.distributedClock = enabled;
+  saveConfig();
+  displayInvalidate();
+
+  return true;
+}
+
 bool setTimezoneCommand(unsigned char nArgs, const char** args, Print* out) {
   if (strlen(args[1]) > CONFIG_TZSIZE) {
     out->printf("Failed: Input too long (max" DEFTOLIT(CONFIG_TZSIZE) ")\n");
@@ -220,12 +306,87 @@ bool displayCommand(unsigned char nArgs, const char** args, Print* out) {
     return false;
   }  
 
+  int transition = TransitionAll;
+
+  if (nArgs > 5 && !argInRange(args[5], 0, TransitionSparkle, &transition)) {
+    out->printf("Failed: Transition out of range 0 to 3\n"); // TransitionSparkle
+    return false;
+  }
+
+  int scroll = 0;
+
+  if (nArgs > 6 && !argInRange(args[6], 0, DISPLAY_MAX_CELLS, &scroll)) {
+    out->printf("Failed: Scroll out of range 0 to %u\n", DISPLAY_MAX_CELLS);
+    return false;
+  }
+
   out->printf("Displaying \"%s\"\n", args[1]);
   
-  displayMessage(args[1], strlen(args[1]), ephemeral, time, (DisplayJustify)justify);
+  displayMessage(args[1], strlen(args[1]), ephemeral, time, (DisplayJustify)justify, (DisplayTransition)transition, scroll);
   return true;
 }
 
+bool setLayoutCommand(unsigned char nArgs, const char** args, Print* out) {
+  int rows;
+  int cols;
+
+  if (!argInRange(args[1], 0, DISPLAY_MAX_CELLS, &rows) || !argInRange(args[2], 0, DISPLAY_MAX_CELLS, &cols)) {
+    out->printf("Failed: Rows and columns out of range 0 to %u\n", DISPLAY_MAX_CELLS);
+    return false;
+  }
+
+  if (!displaySetLayout(rows, cols)) {
+    out->printf("Failed: More cells than modules (max %u)\n", DISPLAY_MAX_CELLS);
+    return false;
+  }
+  saveConfig();
+
+  if (Config.displayRows) {
+    out->printf("Layout set to %u rows of %u\n", rows, cols);
+  } else {
+    out->printf("Layout set to a single row of every module\n");
+  }
+  return true;
+}
+
+bool setLayoutCellCommand(unsigned char nArgs, const char** args, Print* out) {
+  int cell;
+  int addr;
+
+  if (!argInRange(args[1], 0, DISPLAY_MAX_CELLS - 1, &cell)) {
+    out->printf("Failed: Cell out of range 0 to %u\n", DISPLAY_MAX_CELLS - 1);
+    return false;
+  }
+
+  if (!argInRange(args[2], 0, DISPLAY_CELL_EMPTY, &addr) || 
+      (addr != DISPLAY_CELL_MASTER && addr != DISPLAY_CELL_EMPTY && (addr < I2C_DEVADDR_MIN || addr > I2C_DEVADDR_MAX))) {
+    out->printf("Failed: Address should be 0 for master, 255 for empty, or " DEFTOLIT(I2C_DEVADDR_MIN) "-" DEFTOLIT(I2C_DEVADDR_MAX) "\n");
+    return false;
+  }
+
+  if (!displaySetLayoutCell(cell, addr)) {
+    out->printf("Failed: Cell not in the layout, set one with gl first\n");
+    return false;
+  }
+  saveConfig();
+
+  out->printf("Cell %u set to address %u\n", cell, addr);
+  return true;
+}
+
+bool showDisplayedCommand(unsigned char nArgs, const char** args, Print* out) {
+  char buff[DISPLAY_MAX_CELLS * 4 + 1];
+  displayShownText(buff, sizeof(buff));
+  out->printf("Showing \"%s\"\n", buff);
+  return true;
+}
+
+bool reloadCharMapCommand(unsigned char nArgs, const char** args, Print* out) {
+  bool ok = charmapReload(out);
+  displayInvalidate();
+  return ok;
+}
+
 bool showHelpCommand(unsigned char nArgs, const char** args, Print* out) {
   printCommandHelp(out);
   return true;
@@ -252,6 +413,95 @@ bool setMultilineDelayCommand(unsigned char nArgs, const char** args, Print* out
   return true;
 }
 
+bool setFrameIntervalCommand(unsigned char nArgs, const char** args, Print* out) {
+  unsigned int interval;
+
+  if (!argInRange(args[1], 0, 60000, &interval)) {
+    out->printf("Failed: Interval out of range 0 to 60000\n");
+    return false;
+  }
+
+  out->printf("Setting minimum frame interval to %u\n", interval);
+
+  Config.minFrameInterval = interval;
+  saveConfig();
+
+  return true;
+}
+
+bool setMqttCommand(unsigned char nArgs, const char** args, Print* out) {
+  if (nArgs == 1) {
+    *Config.mqttHost = '\0';
+    saveConfig();
+    mqttReconfigure();
+    out->printf("MQTT disabled\n");
+    return true;
+  }
+
+  unsigned int port;
+  if (!argInRange(args[2], 1, 65535, &port)) {
+    out->printf("Failed: Port out of range 1 to 65535\n");
+    return false;
+  }
+
+  if (strlen(args[1]) > MQTT_HOST_SIZE) {
+    out->printf("Failed: Host too long (max " DEFTOLIT(MQTT_HOST_SIZE) ")\n");
+    return false;
+  }
+
+  if (nArgs > 3 && (strlen(args[3]) > MQTT_CREDENTIAL_SIZE || strlen(args[4]) > MQTT_CREDENTIAL_SIZE)) {
+    out->printf("Failed: User or password too long (max " DEFTOLIT(MQTT_CREDENTIAL_SIZE) ")\n");
+    return false;
+  }
+
+  strcpy(Config.mqttHost, args[1]);
+  Config.mqttPort = port;
+  strcpy(Config.mqttUser, nArgs > 3 ? args[3] : "");
+  strcpy(Config.mqttPassword, nArgs > 3 ? args[4] : "");
+  saveConfig();
+  mqttReconfigure();
+
+  out->printf("Connecting to MQTT broker %s:%u\n", Config.mqttHost, port);
+  return true;
+}
+
+bool setMqttTopicCommand(unsigned char nArgs, const char** args, Print* out) {
+  size_t len = strlen(args[1]);
+  if (!len || len > MQTT_TOPIC_SIZE || args[1][len - 1] == '/' || strpbrk(args[1], "+#")) {
+    out->printf("Failed: Topic should be 1 to " DEFTOLIT(MQTT_TOPIC_SIZE) " characters, without wildcards or a trailing /\n");
+    return false;
+  }
+
+  strcpy(Config.mqttTopic, args[1]);
+  saveConfig();
+  mqttReconfigure();
+
+  out->printf("MQTT topics are now under %s/\n", Config.mqttTopic);
+  return true;
+}
+
+bool setMotionBudgetCommand(unsigned char nArgs, const char** args, Print* out) {
+  unsigned int budget;
+
+  if (!argInRange(args[1], 0, DISPLAY_MAX_CELLS, &budget)) {
+    out->printf("Failed: Budget out of range 0 to %u\n", DISPLAY_MAX_CELLS);
+    return false;
+  }
+
+  if (budget) {
+    out->printf("At most %u modules will move at once\n", budget);
+  } else {
+    out->printf("Any number of modules may move at once\n");
+  }
+
+  Config.motionBudget = budget;
+  saveConfig();
+  // Takes a clock back from modules keeping time, see displayEvents()
+  displayInvalidate();
+
+  return true;
+}
+
 bool updateModulesCommand(unsigned char nArgs, const char** args, Print* out) {
   out->print("Beginning module update procedure...");
 
@@ -435,9 +685,27 @@ static Command commands[] = {
   { "r",      0, "Reset",                                                                         resetCommand,           false },
   { "cfg",    0, "Show configuration",                                                            showConfigCommand,      false },
   { "msg",    4, "Display message (msg \"message\" 10 0 2)",                                      displayCommand,         true },
+  { "msg",    5, "Display message with transition (msg \"message\" 10 0 2 [0 all|1 cascade|2 ripple|3 sparkle])", displayCommand, true },
+  { "msg",    6, "Display scrolling message, characters per step (msg \"message\" 10 0 2 0 1)", displayCommand, true },
   { "md",     1, "Set delay in ms between multi-line messages (md 6000)",                         setMultilineDelayCommand,true },
+  { "gl",     2, "Set grid layout, 0 0 for a single row (gl [rows] [columns])",                 setLayoutCommand,       true },
+  { "gc",     2, "Set grid cell's module (gc [cell] [0 master|255 empty|address])",              setLayoutCellCommand,   true },
+  { "ds",     0, "Show what the display is actually showing",                                    showDisplayedCommand,   true },
+  { "fi",     1, "Set minimum ms between display updates, newest wins (fi 250)",                 setFrameIntervalCommand,true },
+  { "cm",     0, "Reload character map from " CHARMAP_PATH,                                       reloadCharMapCommand,   true },
   { "e",      0, "Reenumerate devices",                                                           enumerateDevicesCommand,true },
   { "x",      2, "Send command to slave (x [0 for all|-" DEFTOLIT(I2C_DEVADDR_MAX) "] \"...\")",  sendToModuleCommand,    true },
+  { "mb",     1, "Set most modules moving at once, 0 for no limit (mb 8)",                       setMotionBudgetCommand, true },
+  { "mq",     0, "Disconnect from the MQTT broker",                                              setMqttCommand,         true },
+  { "mq",     2, "Connect to an MQTT broker (mq \"broker.local\" 1883)",                        setMqttCommand,         true },
+  { "mq",     4, "Connect to an MQTT broker with credentials (mq \"broker.local\" 1883 user pass)", setMqttCommand,      true },
+  { "mt",     1, "Set the MQTT topic prefix (mt \"splitflap/lobby\")",                          setMqttTopicCommand,    true },
+  { "dc",     1, "Let modules keep time themselves for time messages (dc [0|1])",                setDistributedClockCommand,true },
+  { "ct",     2, "Set the clock, sent by the master (ct [epoch] [ms])",                         clockTimeCommand,       false },
+  { "cz",     0, "Clear the clock's timezone, sent by the master",                              clockZoneCommand,       false },
+  { "cz",     1, "Set the clock's timezone, sent by the master (cz \"PST8PDT\")",                clockZoneCommand,       false },
+  { "cs",     0, "Stop keeping time",                                                           clockSlotCommand,       false },
+  { "cs",     2, "Keep time showing a character of a strftime conversion (cs %H 0)",             clockSlotCommand,       false },
   { "tz",     1, "Set POSIX timezone (tz \"PST8PDT,M3.2.0/2:00:00,M11.1.0/2:00:00\")",            setTimezoneCommand,     true },
   { "cu",     1, "Connect to adhoc update AP (cu UpdateSSID)",                                    beginUpdateCommand,     false },
   { "xu",     0, "Update modules with host firmware",                                             updateModulesCommand,   true },
@@ -509,42 +777,130 @@ static bool parseCommand(char* command, CommandParams& params, Print* out) {
     return false;
   }
 
+  // A command may be listed more than once, with different numbers of arguments
+  int expectedArgs = -1;
   for (unsigned int i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
     if ((!commands[i].master || Config.isMaster) && !strcmp(params.args[0], commands[i].prefix)) {
       if (params.nArgs != commands[i].nArgs + 1) {
-        out->printf("Command takes %d argument(s)!\n", commands[i].nArgs);
-        return false;
+        if (expectedArgs < 0) expectedArgs = commands[i].nArgs;
+        continue;
       }
       params.func = commands[i].function;
       return true;
     }
   }
+  if (expectedArgs >= 0) {
+    out->printf("Command takes %d argument(s)!\n", expectedArgs);
+    return false;
+  }
   out->print("Unknown command\n");
   printCommandHelp(out);
   return false;
 }
 
-bool handleCommandAsync(char* command, Print* out) {
-  CommandParams params = {0};
+QueuedCommand* commandReserve(const void* owner) {
+  for (QueuedCommand& command : queuedCommands) {
+    if (command.state != CommandFree) continue;
 
-  if (parseCommand(command, params, out)) {
-    noInterrupts();
-    bool queued = false;
-    if (!queuedCommand.queued) {
-      queuedParams = params;
-      queued = queuedCommand.queued = true;
-      queuedCommand.finished = false;
+    // A stream whose buffer couldn't be allocated has no capacity
+    command.output = poolNew<PoolMemoryStream>(COMMAND_OUTPUT_SIZE, PoolAllocator());
+    if (!command.output || !command.output->availableForWrite()) {
+      poolDelete(command.output);
+      command.output = NULL;
+      return NULL;
     }
-    interrupts();
 
-    if (!queued) {
-      out->print("Queued command overflow\n");
-      return false;
-    }
-    return true;
-  } else {
+    command.id = ++lastCommandId;
+    command.state = CommandReceiving;
+    command.succeeded = false;
+    command.released = false;
+    command.attached = false;
+    command.owner = owner;
+    command.params->cmdBuff[0] = '\0';
+    command.output->setWriteTimeout(0);
+    return &command;
+  }
+  return NULL;
+}
+
+QueuedCommand* commandFind(unsigned long id) {
+  for (QueuedCommand& command : queuedCommands) {
+    if (command.state != CommandFree && command.id == id) return &command;
+  }
+  return NULL;
+}
+
+QueuedCommand* commandFindOwner(const void* owner) {
+  for (QueuedCommand& command : queuedCommands) {
+    if (command.state == CommandReceiving && command.owner == owner) return &command;
+  }
+  return NULL;
+}
+
+bool commandAppend(QueuedCommand* command, const uint8_t* data, size_t len) {
+  char* cmdBuff = command->params->cmdBuff;
+  size_t pos = strlen(cmdBuff);
+  if (pos + len >= sizeof(command->params->cmdBuff)) return false;
+
+  memcpy(&cmdBuff[pos], data, len);
+  cmdBuff[pos + len] = '\0';
+  return true;
+}
+
+bool commandSubmit(QueuedCommand* command) {
+  command->owner = NULL;
+
+  if (!parseCommand(command->params->cmdBuff, *command->params, command->output)) {
+    command->state = CommandFinished;
+    command->finishedAt = millis();
     return false;
   }
+  command->state = CommandQueued;
+  return true;
+}
+
+void commandAttach(QueuedCommand* command, bool attached) {
+  command->attached = attached;
+  command->output->setWriteTimeout(attached ? COMMAND_OUTPUT_TIMEOUT : 0);
+}
+
+void commandRelease(QueuedCommand* command) {
+  // Already gone, say after a failed append, and again when its client disconnects
+  if (command->state == CommandFree || !command->output) return;
+
+  commandAttach(command, false);
+  if (command->state == CommandRunning) {
+    command->released = true;
+  } else {
+    commandFree(*command);
+  }
+}
+
+unsigned int commandCount(CommandState state) {
+  unsigned int n = 0;
+  for (QueuedCommand& command : queuedCommands) {
+    if (command.state == state) n++;
+  }
+  return n;
+}
+
+void commandEvents() {
+  QueuedCommand* next = NULL;
+  for (QueuedCommand& command : queuedCommands) {
+    if (command.state == CommandQueued && (!next || command.id < next->id)) next = &command;
+
+    if (command.state == CommandFinished && !command.attached && millis() - command.finishedAt > COMMAND_RESULT_TIMEOUT) {
+      commandFree(command);
+    }
+  }
+  if (!next) return;
+
+  next->state = CommandRunning;
+  next->succeeded = handleCommand(next->params);
+  next->finishedAt = millis();
+  next->state = CommandFinished;
+  if (next->released) commandFree(*next);
+  eventsCommandFinished(next->succeeded);
 }
 
 // Modifies command argument!
@@ -24,6 +24,7 @@ const char* UpdateStatusStr[] = {
   "UPDATE FAILED",
 };
 
+I2CStats i2cStats = {0};
 bool i2cOverflow = false;
 Status deviceLastStatus = MODULE_OK;
 unsigned char knownModules[DISPLAY_MAX_MODULES] = {0};
@@ -65,7 +66,9 @@ char* i2cReadCommand() {
 
 template<typename T> PacketStatus i2cReadStruct(unsigned char addr, T* dst, unsigned char retries) {
   PacketStatus status = PACKET_EMPTY;
-  while (retries--) {
+  for (unsigned char attempt = 0; attempt < retries; attempt++) {
+    i2cStats.reads++;
+    if (attempt) i2cStats.retries++;
     while (Wire.available()) Wire.read();
     delay(1);
     unsigned char nRead = Wire.requestFrom((uint8_t)addr, (uint8_t)sizeof(ModulePacket<T>), (uint8_t)true);
@@ -102,6 +105,7 @@ template<typename T> PacketStatus i2cReadStruct(unsigned char addr, T* dst, unsi
     }
     return PACKET_OK;
   }
+  i2cStats.errors++;
   return status;
 }
 
@@ -29,7 +29,17 @@ void printConfig(Print* out) {
   out->printf("rpm: %u\n", (unsigned int)Config.rpm);
 
   if (Config.isMaster) {
-    out->printf("timeZone: %s\n\n", *Config.timeZone ? Config.timeZone : "<None set>");
+    out->printf("timeZone: %s\n", *Config.timeZone ? Config.timeZone : "<None set>");
+    out->printf("multilineDelay: %u\n", Config.multilineDelay);
+    out->printf("minFrameInterval: %u\n", Config.minFrameInterval);
+    out->printf("distributedClock: %s\n", Config.distributedClock ? "true" : "false");
+    out->printf("motionBudget: %u\n", (unsigned int)Config.motionBudget);
+    if (*Config.mqttHost) {
+      out->printf("mqtt: %s:%u as %s, topics under %s/\n\n", Config.mqttHost, (unsigned int)Config.mqttPort,
+        *Config.mqttUser ? Config.mqttUser : "<Anonymous>", Config.mqttTopic);
+    } else {
+      out->printf("mqtt: <None set>\n\n");
+    }
 
     out->printf("WiFi status: %s\n", wifiStatusStr(WiFi.status()));
     out->printf("IP address: "); WiFi.localIP().printTo(*out); out->printf("\n\n");
@@ -39,5 +49,18 @@ void printConfig(Print* out) {
       out->printf(" %u", (unsigned int)knownModules[i]);
     }
     out->printf("\n");
+
+    if (Config.displayRows) {
+      out->printf("Layout (%u rows of %u):", (unsigned int)Config.displayRows, (unsigned int)Config.displayCols);
+      for (unsigned int i = 0; i < (unsigned int)(Config.displayRows * Config.displayCols); i++) {
+        if (i % Config.displayCols == 0) out->printf("\n ");
+        if (Config.displayLayout[i] == DISPLAY_CELL_MASTER) out->printf(" M");
+        else if (Config.displayLayout[i] == DISPLAY_CELL_EMPTY) out->printf(" -");
+        else out->printf(" %u", (unsigned int)Config.displayLayout[i]);
+      }
+      out->printf("\n");
+    } else {
+      out->printf("Layout: single row\n");
+    }
   }
 }
\ No newline at end of file
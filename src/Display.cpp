@@ -1,151 +1,775 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
+#include <LittleFS.h>
 #include <Wire.h>
 
+#include <sys/time.h>
 #include <time.h>
 
+#include "CharMap.h"
+#include "Clock.h"
 #include "Communication.h"
 #include "Display.h"
+#include "Events.h"
+#include "Justify.h"
 #include "Motor.h"
+#include "Playlist.h"
+#include "TimeService.h"
 
 #include "Config.h"
 
 static struct DisplayTextParams {
   char displayText[DISPLAY_MAX_CHARS+1] = {0};
   unsigned long lastDisplayMillis = 0;
-  unsigned long multilineStartTime = 0;
-  size_t multilinePos = 0;
+  unsigned long multilineStartTime = 0; // When the current page settled, 0 while it's still on its way
+  unsigned int multilinePage = 0;
   bool isTime = false;
+  DisplayTransition transition = TransitionAll;
+  unsigned int timeInterval = 1; // Seconds between changes of the formatted time
+  time_t nextTimeRender = 0;
   DisplayJustify justify = JustifyNone;
+  unsigned int scroll = 0; // Characters per step when scrolling, 0 shows the message a page at a time
+
+  // The message rendered to flaps, one page (the whole grid) after the other. Only the justified text is
+  // capped at DISPLAY_MAX_CHARS, so the last page may need padding past it.
+  // When scrolling, it's instead a strip per row, scrollWidth wide, that the grid is a window onto.
+  unsigned char pageFlaps[DISPLAY_MAX_CHARS + DISPLAY_MAX_CELLS] = {0};
+  unsigned int nPages = 0;
+  unsigned int scrollWidth = 0;
+  bool raw = false; // pageFlaps came as they are from displayFlaps(), there's nothing to render them from
+
+  // Messages too long for displayText are read from this file a page at a time, see renderStoredPage(). Only
+  // whether there's more than one page is known, so nPages is 1 or 2.
+  const char* storedPath = NULL;
+  size_t storedSize = 0;
+  size_t pageOffset = 0; // Where the page in pageFlaps starts in the file
+  size_t nextPageOffset = 0;
+  unsigned int storedPage = 0; // multilinePage when the page in pageFlaps was rendered
+  unsigned int layoutVersion = 0; // Of the layout the pages were rendered for, 0 when they need rendering
 } persistentDisplayParams, ephemeralDisplayParams;
 
+// Which I2C address shows each cell, row by row
+static struct DisplayLayout {
+  unsigned char rows;
+  unsigned char cols;
+  unsigned char cells[DISPLAY_MAX_CELLS];
+  unsigned char nModules; // nKnownModules when the layout was derived
+  unsigned int version; // Bumped on every change, so rendered pages know when they're stale
+  bool dirty;
+} layout = { .dirty = true };
+
 static unsigned long lastEphemeralDisplayMillis = 0;
 static unsigned long ephemeralDisplayDurationMillis = 0;
-static unsigned long lastSeconds = 0;
 static bool displayDirty = false;
 
-const char* findStop(const char* buff, unsigned int buffLen) {
-	for (unsigned int i = 0; i < buffLen; i++) {
-		if (buff[i] == ' ' || buff[i] == '\0' || buff[i] == '|') return &buff[i];
-	}
-	return NULL;
-}
-
-void strShiftRight(char* buff, unsigned int buffLen, unsigned int amt) {
-	// Swap i with i-amt
-	for (int i = buffLen - 1; i >= (int)amt; i--) {
-		auto idx = (i - amt + buffLen) % buffLen;
-		auto tmp = buff[i];
-		buff[i] = buff[idx];
-		buff[idx] = tmp;
-	}
-}
-
-unsigned int rightSpaces(const char* buff, unsigned int buffLen) {
-	int right = 0;
-	for (int n = buffLen - 1; n >= 0; n--) {
-		if (buff[n] != ' ') break;
-		right++;
-	}
-	return right;
-}
-
-unsigned int justifyText(char* dstBuff, unsigned int dstBuffLen, const char* srcBuff, unsigned int srcBuffLen, DisplayJustify justify) {
-	unsigned char lineSize = 8;
-	size_t srcPos = 0;
-	size_t dstPos = 0;
-	unsigned int outLen = 0;
-
-	switch (justify) {
-	case JustifyLeft:
-	case JustifyCenter:
-	case JustifyRight:
-	{
-		// Go through each word (space separated), stopping when we're at the end of the message, or when we've run out of display message space
-		unsigned int spaceLeft = 0;
-		while (srcPos < srcBuffLen && srcBuff[srcPos] != '\0' && dstPos < dstBuffLen) {
-			// Trim leading spaces
-			while (srcBuff[srcPos] == ' ') srcPos++;
-
-			// Find word size
-			const char* nextSpace = findStop(&srcBuff[srcPos], srcBuffLen - srcPos); // strchr(&srcBuff[srcPos], ' ');
-			unsigned int wordSize = min(nextSpace ? (unsigned int)(nextSpace - &srcBuff[srcPos]) : srcBuffLen - srcPos, (unsigned int)lineSize);
-			spaceLeft = min(lineSize - dstPos % lineSize, dstBuffLen - dstPos);
-
-			// If the word fits into the space left in the display...
-			if (wordSize && wordSize <= spaceLeft && srcBuff[srcPos] != '|') {
-				// Copy it (plus space, if room on line, and in buffer) into the buffer
-				memcpy(&dstBuff[dstPos], &srcBuff[srcPos], wordSize);
-				dstPos += wordSize;
-				srcPos += wordSize;
-				if (spaceLeft - wordSize) {
-					dstBuff[dstPos++] = ' ';
-					spaceLeft--;
-				}
-				spaceLeft -= wordSize;
-			}
-			else {
-				// Else, pad the rest of the display, advance dstPos to the next line
-				for (unsigned int i = 0; i < spaceLeft; i++) {
-					dstBuff[dstPos++] = ' ';
-				}
-				if (srcBuff[srcPos] == '|') { // Forced line break
-					srcPos++;
-				}
-				spaceLeft = 0;
-			}
-		}
-		if (spaceLeft) {
-			for (unsigned int i = 0; i < spaceLeft && dstPos < dstBuffLen; i++) {
-				dstBuff[dstPos++] = ' ';
-			}
-		}
-		outLen = dstPos;
-		break;
-	}
-	default:
-		strncpy(dstBuff, srcBuff, dstBuffLen);
-		outLen = strlen(dstBuff);
-		break;
-	}
-
-	// Don't handle the last line if it's truncated, display it verbatim
-	for (unsigned int i = 0; i + lineSize <= outLen; i += lineSize) {
-		switch (justify) {
-		case JustifyCenter:
-		{
-			// Find rightmost character
-			int right = rightSpaces(&dstBuff[i], lineSize);
-			right /= 2;
-			strShiftRight(&dstBuff[i], lineSize, right);
-			break;
-		}
-		case JustifyRight:
-		{
-			// Find rightmost character
-			int right = rightSpaces(&dstBuff[i], lineSize);
-			strShiftRight(&dstBuff[i], lineSize, right);
-			break;
-		}
-		case JustifyLeft:
-		default:
-			// Should already be left justified
-			break;
-		}
-	}
-
-	return outLen;
-}
-
-inline char charToFlap(char c) {
-  #include "CharFlapMap.h"
-  return CharFlapMap[((c < 32 ? 32 : c) & 127)-32];
+// Messages waiting for the minimum frame interval to pass. Only the newest of each kind is kept.
+static struct PendingMessage {
+  char text[DISPLAY_MAX_CHARS+1];
+  unsigned int seconds;
+  bool isTime;
+  DisplayJustify justify;
+  DisplayTransition transition;
+  unsigned int scroll;
+  bool stored; // The text is in the pending file, see displayStoredMessage()
+  unsigned int nFlaps; // When not 0, text is instead a flap per cell, see displayFlaps()
+  bool pending;
+} pendingPersistent, pendingEphemeral;
+
+static unsigned long lastMessageMillis = 0;
+
+DisplayStats displayStats = {0};
+
+// What each cell of the wall should be, and is, showing. Only changes go out on the bus, and once the modules
+// have had time to get there we read their status back, resending anything that didn't land.
+// Flaps are MOTOR_FLAPS when unknown.
+static struct CellState {
+  unsigned char commanded;
+  unsigned char confirmed;
+  unsigned char retries;
+  unsigned long landsAt; // When it's predicted to stop moving, in millis()
+} shadow[DISPLAY_MAX_CELLS];
+
+static unsigned long confirmAt = 0; // When to start reading back unconfirmed cells, 0 when there are none
+static unsigned int confirmCell = 0;
+static bool confirmPending = false;
+
+// When each cell starts moving relative to the start of a frame, rebuilt only when the effect or layout changes
+static struct TransitionSchedule {
+  DisplayTransition transition;
+  unsigned int layoutVersion;
+  unsigned int offsets[DISPLAY_MAX_CELLS]; // ms
+} schedule = { .transition = TransitionAll, .layoutVersion = 0 };
+
+// What each cell shows of a clock the modules keep themselves, see renderClock()
+static struct ClockSlot {
+  char conversion[CLOCK_CONVERSION_SIZE]; // Empty for cells showing something fixed
+  unsigned char index;
+} clockSlots[DISPLAY_MAX_CELLS];
+
+// The frame being sent, cells go out as their offset comes up
+static unsigned long frameStart = 0;
+static unsigned long frameEta = 0; // When every module should have landed
+static unsigned char frameFlaps[DISPLAY_MAX_CELLS];
+static bool frameQueued[DISPLAY_MAX_CELLS] = {0};
+static bool framePending = false;
+
+static bool isKnownModule(unsigned char addr) {
+  for (unsigned int i = 0; i < nKnownModules; i++) {
+    if (knownModules[i] == addr) return true;
+  }
+  return false;
+}
+
+// Address 0 is the general call, which every module listens to
+static void sendCommand(unsigned char addr, const char* command, unsigned char nRetries) {
+  unsigned char res;
+  bool retry = false;
+  do {
+    i2cStats.writes++;
+    if (retry) i2cStats.retries++;
+    retry = true;
+    Wire.beginTransmission(addr);
+    Wire.write(command);
+    Wire.write(0);
+    res = Wire.endTransmission();
+    delayMicroseconds(500); // To make it easier to see in the logic analyzer
+  } while (res != 0 && nRetries--);
+  if (res != 0) i2cStats.errors++;
+}
+
+// Whether a cell has a module to show it. Cells for modules that didn't show up during enumeration are left
+// out of frames, rather than waiting on a module that will never answer.
+static bool isLiveCell(unsigned int cell) {
+  unsigned char addr = layout.cells[cell];
+  return addr == DISPLAY_CELL_MASTER || (addr != DISPLAY_CELL_EMPTY && isKnownModule(addr));
+}
+
+// Derive the layout from the config, or when none is set, a single row of the master followed by every module
+static void updateLayout() {
+  if (!layout.dirty && layout.nModules == nKnownModules) return;
+
+  layout.dirty = false;
+  layout.nModules = nKnownModules;
+  layout.version++;
+
+  // Cells may now belong to other modules, or none. Modules left out of the layout would otherwise keep time
+  // forever, so every one stops, and those still in it are given their slots again when the clock is next sent.
+  clockStop();
+  sendCommand(0, "cs", 0);
+  for (unsigned int i = 0; i < DISPLAY_MAX_CELLS; i++) {
+    shadow[i].commanded = shadow[i].confirmed = MOTOR_FLAPS;
+    frameQueued[i] = false;
+  }
+  confirmAt = 0;
+  framePending = false;
+
+  if (Config.displayRows && Config.displayCols) {
+    layout.rows = Config.displayRows;
+    layout.cols = Config.displayCols;
+    memcpy(layout.cells, Config.displayLayout, sizeof(layout.cells));
+  } else {
+    layout.rows = 1;
+    layout.cols = nKnownModules + 1;
+    layout.cells[0] = DISPLAY_CELL_MASTER;
+    memcpy(&layout.cells[1], knownModules, nKnownModules);
+  }
+}
+
+static void sendFlap(unsigned char addr, unsigned char flap) {
+  if (addr == DISPLAY_CELL_MASTER) {
+    clockStop();
+    motorMoveToFlap(flap);
+    return;
+  }
+
+  // Unassigned cells, or modules which didn't show up during enumeration
+  if (addr == DISPLAY_CELL_EMPTY || !isKnownModule(addr)) return;
+
+  char buff[6];
+  snprintf(buff, 6, "f %d", flap);
+  sendCommand(addr, buff, 5);
+}
+
+// Worst case for a module to get to any flap, a whole revolution
+static unsigned long settleMillis() {
+  return motorTravelMillis(MOTOR_FLAPS, 0) + DISPLAY_SETTLE_MARGIN;
+}
+
+static void buildSchedule(DisplayTransition transition) {
+  unsigned int pageSize = layout.rows * layout.cols;
+
+  if (transition == TransitionSparkle) {
+    // Random order, spread over as long as a cascade would take. Shuffled in place every frame.
+    if (schedule.transition != transition || schedule.layoutVersion != layout.version) {
+      for (unsigned int cell = 0; cell < pageSize; cell++) {
+        schedule.offsets[cell] = cell * DISPLAY_TRANSITION_STEP * layout.cols / pageSize;
+      }
+    }
+    for (unsigned int cell = pageSize - 1; cell > 0; cell--) {
+      unsigned int other = random(cell + 1);
+      unsigned int tmp = schedule.offsets[cell];
+      schedule.offsets[cell] = schedule.offsets[other];
+      schedule.offsets[other] = tmp;
+    }
+  } else if (schedule.transition != transition || schedule.layoutVersion != layout.version) {
+    for (unsigned int cell = 0; cell < pageSize; cell++) {
+      unsigned int row = cell / layout.cols;
+      unsigned int col = cell % layout.cols;
+      switch (transition) {
+        case TransitionCascade:
+          schedule.offsets[cell] = col * DISPLAY_TRANSITION_STEP;
+          break;
+        case TransitionRipple:
+          // Distance from the center in half cells
+          schedule.offsets[cell] = (abs(2 * (int)col - (layout.cols - 1)) + abs(2 * (int)row - (layout.rows - 1))) * DISPLAY_TRANSITION_STEP / 2;
+          break;
+        default:
+          schedule.offsets[cell] = 0;
+          break;
+      }
+    }
+  }
+
+  schedule.transition = transition;
+  schedule.layoutVersion = layout.version;
+}
+
+// How many more modules may start moving now, with Config.motionBudget set
+static unsigned int motionAvailable(unsigned long now) {
+  if (!Config.motionBudget) return UINT_MAX;
+
+  unsigned int pageSize = layout.rows * layout.cols;
+  unsigned int moving = 0;
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    if ((long)(shadow[cell].landsAt - now) > 0) moving++;
+  }
+  return moving < Config.motionBudget ? Config.motionBudget - moving : 0;
+}
+
+// The queued cell with the longest way to go, of those whose start time has come, or -1
+static int longestDue(unsigned long elapsed) {
+  unsigned int pageSize = layout.rows * layout.cols;
+  unsigned long longest = 0;
+  int next = -1;
+
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    if (!frameQueued[cell] || schedule.offsets[cell] > elapsed) continue;
+    unsigned long travel = motorTravelMillis(shadow[cell].commanded, frameFlaps[cell]);
+    if (next < 0 || travel > longest) {
+      next = cell;
+      longest = travel;
+    }
+  }
+  return next;
+}
+
+// Sends the cells of the current frame whose start time has come. Once the whole frame is out, it's time to
+// start waiting for the modules to settle.
+// Only so many modules may be moving at once with a motion budget, as each draws its full coil current while it
+// does. The longest moves go first, as the frame can't settle before they do, and the short ones fill in behind.
+static void dispatchFrame() {
+  if (!framePending) return;
+
+  unsigned int pageSize = layout.rows * layout.cols;
+  unsigned long now = millis();
+  unsigned long elapsed = now - frameStart;
+  unsigned int available = motionAvailable(now);
+  bool pending = false;
+
+  for (int cell; available && (cell = longestDue(elapsed)) >= 0; available--) {
+    frameQueued[cell] = false;
+    shadow[cell].landsAt = now + motorTravelMillis(shadow[cell].commanded, frameFlaps[cell]);
+    sendFlap(layout.cells[cell], frameFlaps[cell]);
+    shadow[cell].commanded = frameFlaps[cell];
+    shadow[cell].retries = 0;
+  }
+
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    pending = pending || frameQueued[cell];
+  }
+
+  if (!pending) {
+    framePending = false;
+    // Read back once they should all be there
+    confirmAt = frameEta + DISPLAY_SETTLE_MARGIN;
+    confirmCell = 0;
+    confirmPending = false;
+  }
+}
+
+// Plays dispatchFrame() forward for the queued frame, with the budget's worth of modules moving at once, longest
+// move first. ms from the frame's start.
+static unsigned long budgetedEta() {
+  unsigned int pageSize = layout.rows * layout.cols;
+  unsigned long slots[DISPLAY_MAX_CELLS]; // When each of the budget's modules is free again
+  unsigned int nSlots = Config.motionBudget < pageSize ? Config.motionBudget : pageSize;
+  bool scheduled[DISPLAY_MAX_CELLS] = {0};
+  unsigned long eta = 0;
+
+  for (unsigned int i = 0; i < nSlots; i++) {
+    slots[i] = 0;
+  }
+
+  // Modules still on their way from earlier frames, or resends, hold a slot until they land. Only the longest
+  // nSlots matter, the rest land before any of those free up.
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    long remaining = shadow[cell].landsAt - frameStart;
+    if (remaining <= 0) continue;
+
+    unsigned int slot = 0;
+    for (unsigned int i = 1; i < nSlots; i++) {
+      if (slots[i] < slots[slot]) slot = i;
+    }
+    if ((unsigned long)remaining > slots[slot]) slots[slot] = remaining;
+  }
+
+  while (true) {
+    int next = -1;
+    unsigned long longest = 0;
+    for (unsigned int cell = 0; cell < pageSize; cell++) {
+      if (!frameQueued[cell] || scheduled[cell]) continue;
+      unsigned long travel = motorTravelMillis(shadow[cell].commanded, frameFlaps[cell]);
+      if (next < 0 || travel > longest) {
+        next = cell;
+        longest = travel;
+      }
+    }
+    if (next < 0) break;
+    scheduled[next] = true;
+
+    unsigned int slot = 0;
+    for (unsigned int i = 1; i < nSlots; i++) {
+      if (slots[i] < slots[slot]) slot = i;
+    }
+    unsigned long start = slots[slot] > schedule.offsets[next] ? slots[slot] : schedule.offsets[next];
+    slots[slot] = start + longest;
+    if (slots[slot] > eta) eta = slots[slot];
+  }
+  return eta;
+}
+
+// With landAt (in millis()), modules start as long before it as they'll take to get there, instead of following
+// the transition, so they all land together
+static void sendPage(const unsigned char* page, DisplayTransition transition, unsigned long landAt = 0) {
+  unsigned int pageSize = layout.rows * layout.cols;
+  bool changed = false;
+
+  // Every row of the page goes out in the same frame. A new frame replaces whatever of the last one hasn't
+  // been sent yet.
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    frameQueued[cell] = shadow[cell].commanded != page[cell] && isLiveCell(cell);
+    frameFlaps[cell] = page[cell];
+    changed = changed || frameQueued[cell];
+  }
+
+  if (!changed) return;
+
+  frameStart = millis();
+
+  if (landAt) {
+    for (unsigned int cell = 0; cell < pageSize; cell++) {
+      if (!frameQueued[cell]) continue;
+      long start = (long)(landAt - frameStart) - (long)motorTravelMillis(shadow[cell].commanded, page[cell]);
+      schedule.offsets[cell] = start > 0 ? start : 0;
+    }
+    // No longer any transition's schedule
+    schedule.layoutVersion = 0;
+  } else {
+    buildSchedule(transition);
+  }
+
+  unsigned long eta = 0;
+  if (Config.motionBudget) {
+    eta = budgetedEta();
+  } else {
+    for (unsigned int cell = 0; cell < pageSize; cell++) {
+      if (!frameQueued[cell]) continue;
+      unsigned long cellEta = schedule.offsets[cell] + motorTravelMillis(shadow[cell].commanded, page[cell]);
+      if (cellEta > eta) eta = cellEta;
+    }
+  }
+
+  frameEta = frameStart + eta;
+  framePending = true;
+  displayStats.frames++;
+  dispatchFrame();
+}
+
+static void confirmCellFlap(unsigned int cell) {
+  CellState& state = shadow[cell];
+  unsigned char addr = layout.cells[cell];
+  Status status;
+  unsigned char flap;
+
+  if (addr == DISPLAY_CELL_MASTER) {
+    status = deviceLastStatus;
+    flap = motorCurrentFlap();
+  } else {
+    ModuleStatus moduleStatus;
+    if (!isKnownModule(addr) || i2cReadStruct(addr, &moduleStatus) != PACKET_OK) {
+      // Try again next pass, but don't hold the bus forever for a module that's gone
+      if (state.retries++ < DISPLAY_CONFIRM_RETRIES) confirmPending = true;
+      return;
+    }
+    status = moduleStatus.status;
+    flap = moduleStatus.flap;
+    eventsModuleStatus(addr, status, flap);
+  }
+
+  if (status == MODULE_MOVING || status == MODULE_CALIBRATING) {
+    confirmPending = true;
+    return;
+  }
+
+  if (status != MODULE_STALLED && flap == state.commanded) {
+    state.confirmed = flap;
+    return;
+  }
+
+  // It missed the command, or garbled it. Stalled modules need a calibrate before they move again.
+  state.confirmed = status == MODULE_STALLED ? MOTOR_FLAPS : flap;
+  if (status != MODULE_STALLED && state.retries < DISPLAY_CONFIRM_RETRIES) {
+    // A resend is a move like any other, it waits for the next pass if the budget's used up
+    confirmPending = true;
+    if (!motionAvailable(millis())) return;
+
+    state.retries++;
+    LOG("Module "); LOG(addr); LOGLN(" missed its flap, resending");
+    sendFlap(addr, state.commanded);
+    state.landsAt = millis() + motorTravelMillis(flap, state.commanded);
+  }
+}
+
+// Reads back one cell per call, so a big wall doesn't stall loop()
+static void confirmEvents() {
+  if (!confirmAt || (long)(millis() - confirmAt) < 0) return;
+
+  unsigned int pageSize = layout.rows * layout.cols;
+
+  for (; confirmCell < pageSize; confirmCell++) {
+    CellState& state = shadow[confirmCell];
+    if (state.commanded >= MOTOR_FLAPS || state.commanded == state.confirmed || !isLiveCell(confirmCell)) continue;
+    confirmCellFlap(confirmCell++);
+    return;
+  }
+
+  // Finished a pass, give anything still moving or resent time to get there
+  confirmCell = 0;
+  confirmAt = confirmPending ? millis() + settleMillis() : 0;
+  confirmPending = false;
+}
+
+// How often the output of a strftime format can change, in seconds. Anything coarser than minutes is still
+// checked every minute, since time zone and DST offsets aren't always whole hours.
+static unsigned int timeFormatInterval(const char* format) {
+  for (const char* c = strchr(format, '%'); c && *++c; c = strchr(c, '%')) {
+    // Alternative representations (%Ec, %OS, ...) change just as often
+    if (*c == 'E' || *c == 'O') c++;
+    switch (*c) {
+      case 'S': case 'T': case 'r': case 'X': case 'c': case 's': case '+':
+        return 1;
+      case '\0':
+        return 60;
+    }
+    c++; // Also skips the second half of %%
+  }
+  return 60;
+}
+
+// Each '|' separated line of the message goes on its own row, followed by a grid's width of blanks so its end
+// scrolls off before its start comes back around. Lines past the last row are dropped.
+static void renderStrip(DisplayTextParams& params, const char* glyphs, unsigned int nGlyphs) {
+  unsigned int maxWidth = sizeof(params.pageFlaps) / layout.rows;
+  unsigned int lineLen = 0;
+  unsigned int longest = 0;
+
+  for (unsigned int i = 0; i <= nGlyphs; i++) {
+    if (i == nGlyphs || glyphs[i] == '|') {
+      if (lineLen > longest) longest = lineLen;
+      lineLen = 0;
+    } else {
+      lineLen++;
+    }
+  }
+
+  params.scrollWidth = longest + layout.cols < maxWidth ? longest + layout.cols : maxWidth;
+  memset(params.pageFlaps, charmapFlap(' '), params.scrollWidth * layout.rows);
+
+  unsigned int row = 0;
+  unsigned int col = 0;
+  for (unsigned int i = 0; i < nGlyphs && row < layout.rows; i++) {
+    if (glyphs[i] == '|') {
+      row++;
+      col = 0;
+    } else if (col < params.scrollWidth) {
+      params.pageFlaps[row * params.scrollWidth + col++] = charmapFlap(glyphs[i]);
+    }
+  }
+
+  params.nPages = 1;
+  params.layoutVersion = layout.version;
+
+  LOG("Rendered strip "); LOG(params.scrollWidth); LOG(" wide: ");
+  for (unsigned int i = 0; i < nGlyphs; i++) LOG(glyphs[i]);
+  LOGLN();
+}
+
+// One byte per character from here on, so justification counts modules rather than UTF-8 bytes
+static unsigned int layoutText(char* justifiedText, const char* text, DisplayJustify justify) {
+  char glyphs[DISPLAY_MAX_CHARS];
+  // Only whole lines, so the last one is justified too
+  unsigned int maxLen = DISPLAY_MAX_CHARS - DISPLAY_MAX_CHARS % layout.cols;
+  unsigned int nGlyphs = charmapTranscode(glyphs, sizeof(glyphs), text, DISPLAY_MAX_CHARS);
+  return justifyText(justifiedText, maxLen, glyphs, nGlyphs, justify, layout.cols);
+}
+
+static long long millisUntil(time_t when) {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return (long long)(when - now.tv_sec) * 1000 - now.tv_usec / 1000;
+}
+
+// How far ahead of a change in the time modules may start moving. At most a revolution, which is as long as any
+// module can need, but no further than the previous change.
+static unsigned long prerollMillis(const DisplayTextParams& params) {
+  unsigned long revolution = motorTravelMillis(MOTOR_FLAPS, 0);
+  unsigned long interval = params.timeInterval * 1000UL;
+  return revolution < interval ? revolution : interval;
+}
+
+// Justify the text to the current layout and map every character to its flap, so showing a page is just a lookup
+static void renderPages(DisplayTextParams& params, const char* text, DisplayJustify justify) {
+  char justifiedText[DISPLAY_MAX_CHARS];
+  unsigned int pageSize = layout.rows * layout.cols;
+
+  if (params.scroll) {
+    char glyphs[DISPLAY_MAX_CHARS];
+    renderStrip(params, glyphs, charmapTranscode(glyphs, sizeof(glyphs), text, DISPLAY_MAX_CHARS));
+    return;
+  }
+
+  unsigned int len = layoutText(justifiedText, text, justify);
+
+  params.nPages = len ? (len + pageSize - 1) / pageSize : 1;
+  for (unsigned int i = 0; i < params.nPages * pageSize; i++) {
+    params.pageFlaps[i] = charmapFlap(i < len ? justifiedText[i] : ' ');
+  }
+  params.layoutVersion = layout.version;
+
+  LOG("Rendered: ");
+  for (unsigned int i = 0; i < len; i++) {
+    if (i && i % layout.cols == 0) LOG('|');
+    LOG(justifiedText[i]);
+  }
+  LOGLN();
+}
+
+// Lays out a clock for the modules to keep themselves. Each character a conversion produces stands in as a
+// placeholder byte, numbered from 1, so the format can be justified as if it were the formatted time.
+// Cells keeping time are MOTOR_FLAPS in the page. Returns false if the clock doesn't fit on one page, or has
+// too many characters that change, and the master should render it as usual.
+static bool renderClock(DisplayTextParams& params, const tm* timeInfo) {
+  char text[DISPLAY_MAX_CHARS+1];
+  char justifiedText[DISPLAY_MAX_CHARS];
+  ClockSlot placeholders[DISPLAY_CLOCK_MAX_SLOTS];
+  unsigned int nPlaceholders = 0;
+  unsigned int pageSize = layout.rows * layout.cols;
+  unsigned int len = 0;
+
+  for (const char* c = params.displayText; *c && len < DISPLAY_MAX_CHARS; c++) {
+    if (*c != '%') {
+      text[len++] = *c;
+      continue;
+    }
+
+    const char* start = c++;
+    if (*c == '%') {
+      text[len++] = '%';
+      continue;
+    }
+    if (*c == 'E' || *c == 'O') c++;
+    if (!*c) break;
+
+    char conversion[CLOCK_CONVERSION_SIZE] = {0};
+    memcpy(conversion, start, c - start + 1);
+    char formatted[32];
+    unsigned int formattedLen = strftime(formatted, sizeof(formatted), conversion, timeInfo);
+
+    for (unsigned int i = 0; i < formattedLen && len < DISPLAY_MAX_CHARS; i++) {
+      if (nPlaceholders >= DISPLAY_CLOCK_MAX_SLOTS) return false;
+      memcpy(placeholders[nPlaceholders].conversion, conversion, sizeof(conversion));
+      placeholders[nPlaceholders].index = i;
+      text[len++] = ++nPlaceholders;
+    }
+  }
+  text[len] = '\0';
+
+  len = layoutText(justifiedText, text, params.justify);
+  if (len > pageSize) return false;
+
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    unsigned char c = cell < len ? justifiedText[cell] : ' ';
+    if (c && c <= nPlaceholders) {
+      clockSlots[cell] = placeholders[c - 1];
+      params.pageFlaps[cell] = MOTOR_FLAPS;
+    } else {
+      clockSlots[cell].conversion[0] = '\0';
+      params.pageFlaps[cell] = charmapFlap(c);
+    }
+  }
+  params.nPages = 1;
+  params.layoutVersion = layout.version;
+
+  LOGLN("Rendered clock for the modules to keep");
+  return true;
+}
+
+// The time and time zone go to every module at once, then each module keeping time gets its slot. They aren't
+// commanded to any flap from here on, so aren't resent or read back.
+static void sendClock() {
+  unsigned int pageSize = layout.rows * layout.cols;
+  char command[CONFIG_TZSIZE + 8];
+  timeval now;
+
+  if (*Config.timeZone) {
+    snprintf(command, sizeof(command), "cz \"%s\"", Config.timeZone);
+  } else {
+    strcpy(command, "cz");
+  }
+  sendCommand(0, command, 0);
+
+  gettimeofday(&now, NULL);
+  snprintf(command, sizeof(command), "ct %lu %u", (unsigned long)now.tv_sec, (unsigned int)(now.tv_usec / 1000));
+  sendCommand(0, command, 0);
+
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    if (!clockSlots[cell].conversion[0]) continue;
+
+    unsigned char addr = layout.cells[cell];
+    if (addr == DISPLAY_CELL_MASTER) {
+      clockSetSlot(clockSlots[cell].conversion, clockSlots[cell].index);
+    } else if (addr != DISPLAY_CELL_EMPTY && isKnownModule(addr)) {
+      snprintf(command, sizeof(command), "cs %s %u", clockSlots[cell].conversion, clockSlots[cell].index);
+      sendCommand(addr, command, 5);
+    }
+
+    shadow[cell].commanded = shadow[cell].confirmed = MOTOR_FLAPS;
+  }
+}
+
+// Lays out the page at pageOffset, reading no more of the file than could fit on it. Pages are shown in order,
+// so when multilinePage moves on, the next page starts where this one stopped, and after the last comes the first.
+static void renderStoredPage(DisplayTextParams& params, bool restart) {
+  char text[DISPLAY_MAX_CHARS];
+  char glyphs[DISPLAY_MAX_CHARS];
+  char justifiedText[DISPLAY_MAX_CELLS];
+  unsigned int pageSize = layout.rows * layout.cols;
+
+  if (restart) {
+    params.pageOffset = params.nextPageOffset = 0;
+    params.multilinePage = 0;
+  } else if (params.multilinePage != params.storedPage) {
+    params.pageOffset = params.nextPageOffset < params.storedSize ? params.nextPageOffset : 0;
+    if (!params.pageOffset) params.multilinePage = 0;
+  }
+  params.storedPage = params.multilinePage;
+
+  unsigned int len = 0;
+  File file = LittleFS.open(params.storedPath, "r");
+  if (file && file.seek(params.pageOffset)) len = file.read((uint8_t*)text, sizeof(text));
+
+  // Leave a character the window cuts in half for the next page
+  if (params.pageOffset + len < params.storedSize) {
+    unsigned int end = len;
+    while (end && (text[end - 1] & 0xC0) == 0x80) end--;
+    if (end && (text[end - 1] & 0x80)) len = end - 1;
+  }
+
+  size_t consumed = 0;
+  unsigned int nGlyphs = charmapTranscode(glyphs, sizeof(glyphs), text, len);
+  unsigned int n = justifyText(justifiedText, pageSize, glyphs, nGlyphs, params.justify, layout.cols, &consumed);
+  // Nothing that fits, so there's nothing more to show
+  params.nextPageOffset = consumed ? params.pageOffset + charmapUtf8Bytes(text, len, consumed) : params.storedSize;
+
+  for (unsigned int cell = 0; cell < pageSize; cell++) {
+    params.pageFlaps[cell] = charmapFlap(cell < n ? justifiedText[cell] : ' ');
+  }
+  params.nPages = params.pageOffset || params.nextPageOffset < params.storedSize ? 2 : 1;
+  params.layoutVersion = layout.version;
+
+  LOG("Rendered stored page at "); LOG(params.pageOffset); LOG(" of "); LOGLN(params.storedSize);
+}
+
+static void applyMessage(PendingMessage& message) {
+  auto &params = message.seconds ? ephemeralDisplayParams : persistentDisplayParams;
+
+  if (message.stored) {
+    const char* path = message.seconds ? MESSAGE_EPHEMERAL_PATH : MESSAGE_PATH;
+    LittleFS.rename(message.seconds ? MESSAGE_EPHEMERAL_PENDING_PATH : MESSAGE_PENDING_PATH, path);
+    File file = LittleFS.open(path, "r");
+    params.storedSize = file ? file.size() : 0;
+    params.storedPath = path;
+  } else if (params.storedPath) {
+    LittleFS.remove(params.storedPath);
+    params.storedPath = NULL;
+  }
+  
+  params.isTime = message.isTime;
+  params.justify = message.justify;
+  params.transition = message.transition;
+  params.scroll = message.scroll;
+  memcpy(params.displayText, message.text, sizeof(params.displayText));
+  
+  // Clear ephemeral message either way
+  lastEphemeralDisplayMillis = millis();
+  ephemeralDisplayDurationMillis = message.seconds * 1000;
+
+  params.multilineStartTime = params.multilinePage = 0;
+
+  params.raw = message.nFlaps;
+  if (params.raw) {
+    // Cells the frame doesn't cover are blank, including any a later layout adds
+    memset(params.pageFlaps, charmapFlap(' '), DISPLAY_MAX_CELLS);
+    memcpy(params.pageFlaps, message.text, message.nFlaps);
+    params.displayText[0] = '\0';
+    params.nPages = 1;
+  }
+
+  // Time is rendered on every refresh, everything else once, here
+  updateLayout();
+  if (params.isTime) {
+    params.layoutVersion = 0;
+    params.timeInterval = timeFormatInterval(params.displayText);
+    params.nextTimeRender = 0;
+  } else if (params.storedPath) {
+    renderStoredPage(params, true);
+  } else if (params.raw) {
+    params.layoutVersion = layout.version;
+  } else {
+    renderPages(params, params.displayText, params.justify);
+  }
+
+  message.pending = false;
+  lastMessageMillis = millis();
+  displayDirty = true;
+}
+
+// Bursts of messages collapse into the newest one. Modules that are already moving just get a new target.
+static void applyPendingMessages() {
+  if (!pendingPersistent.pending && !pendingEphemeral.pending) return;
+  if (millis() - lastMessageMillis < Config.minFrameInterval) return;
+
+  // An ephemeral message only stays pending if it came after the persistent one
+  if (pendingPersistent.pending) applyMessage(pendingPersistent);
+  if (pendingEphemeral.pending) applyMessage(pendingEphemeral);
 }
 
 void displayEvents() {
-  char currentDisplayText[DISPLAY_MAX_CHARS] = {0};
-  unsigned int currentDisplayTextLen = 0;
-  unsigned int lineSize = nKnownModules + 1;
+  playlistEvents();
+  updateLayout();
+  applyPendingMessages();
+
+  unsigned int pageSize = layout.rows * layout.cols;
 
   if (ephemeralDisplayDurationMillis) {
     if (millis() - lastEphemeralDisplayMillis > ephemeralDisplayDurationMillis) {
@@ -157,108 +781,223 @@ void displayEvents() {
   auto &params = ephemeralDisplayDurationMillis ? ephemeralDisplayParams : persistentDisplayParams;
 
   unsigned long curTime = millis();
-  unsigned long curSeconds = curTime / 1000; // 1s update
 
-  if (params.isTime && curSeconds != lastSeconds) {
-    displayDirty = true;
+  dispatchFrame();
+  confirmEvents();
+
+  // Only re-render the time when it can have changed, or is about to. Modules that have a long way to go start
+  // early, so the new time lands as it changes rather than after.
+  long long untilTimeRender = params.isTime ? millisUntil(params.nextTimeRender) : 0;
+  bool timeTick = params.isTime && untilTimeRender <= (long long)prerollMillis(params);
+
+  if (params.scroll) {
+    // Each step starts from when the last one landed, going by the prediction or the read back, whichever
+    // comes first. Only cells whose character changes go out, see sendPage().
+    if (!params.multilineStartTime && !framePending && (displaySettled() || !displayEta())) {
+      params.multilineStartTime = curTime;
+    }
+
+    if (params.multilineStartTime && curTime - params.multilineStartTime > DISPLAY_SCROLL_HOLD) {
+      params.multilinePage += params.scroll;
+      params.multilineStartTime = 0;
+      displayDirty = true;
+    }
+  } else {
+    // Each page gets the whole delay to be read, counted from when the wall has settled on it
+    if (params.nPages > 1 && !params.multilineStartTime && displaySettled()) {
+      params.multilineStartTime = curTime;
+    }
+
+    if (params.multilineStartTime && curTime - params.multilineStartTime > Config.multilineDelay) {
+      params.multilinePage++;
+      params.multilineStartTime = 0;
+      displayDirty = true;
+    }
   }
 
-  if (params.multilineStartTime && curTime - params.multilineStartTime > Config.multilineDelay) {
-    params.multilinePos += lineSize;
-    params.multilineStartTime = curTime;
+  // The layout or the module count changed since the message was rendered. The time is rendered below.
+  if (params.nPages && params.layoutVersion != layout.version) {
+    if (params.storedPath) renderStoredPage(params, true);
+    else if (params.raw) params.layoutVersion = layout.version;
+    else if (!params.isTime) renderPages(params, params.displayText, params.justify);
     displayDirty = true;
   }
 
-  if (displayDirty) {
-    memset(currentDisplayText, 0, sizeof(currentDisplayText));
-    
+  bool clockOnModules = false;
+  unsigned long landAt = 0;
+
+  if (displayDirty || timeTick) {
     if (params.isTime) {
-      static bool timeConfigured = false;
-
-      if (!timeConfigured) {
-        if (!WiFi.isConnected()) {      
-          LOGLN("Wifi unavailable, couldn't configure time");
-          strcpy(currentDisplayText, "NO WIFI");
-          currentDisplayTextLen = sizeof("NO WIFI") - 1;
-        } else {
-          tm timeInfo;
-          LOGLN("Configuring time");
-          configTime(Config.timeZone, "pool.ntp.org");          
-          if (getLocalTime(&timeInfo)) {
-            timeConfigured = true;
-          } else {
-            strcpy(currentDisplayText, "NO TIME");
-            currentDisplayTextLen = sizeof("NO TIME") - 1;
-          }
-        }
-      } 
-      if (timeConfigured) {
-        tm timeInfo;
-        if (getLocalTime(&timeInfo)) {
-          char timeBuff[DISPLAY_MAX_CHARS+1];
-          strftime(timeBuff, DISPLAY_MAX_CHARS, params.displayText, &timeInfo);
-          currentDisplayTextLen = justifyText(currentDisplayText, DISPLAY_MAX_CHARS, timeBuff, DISPLAY_MAX_CHARS, params.justify);
-        } else {
-          strcpy(currentDisplayText, "NO TIME");
-          currentDisplayTextLen = sizeof("NO TIME") - 1;
+      const char* status = NULL;
+      tm timeInfo;
+
+      // Until the first sync, with the time service still trying in the background
+      if (!timeNow(&timeInfo)) {
+        status = WiFi.isConnected() ? "NO TIME" : "NO WIFI";
+      } else if (Config.distributedClock && !Config.motionBudget && !charmapCustom() && !params.scroll && renderClock(params, &timeInfo)) {
+        // Modules keeping time move on their own, all at once, so with a motion budget the time is sent as frames.
+        // They also map characters to flaps with their own map, not one loaded on the master.
+        clockOnModules = true;
+      } else {
+        char timeBuff[DISPLAY_MAX_CHARS+1];
+        // Ahead of a change, render the time as it will be, to land when it is
+        if (timeTick && !displayDirty && params.nextTimeRender) {
+          localtime_r(&params.nextTimeRender, &timeInfo);
+          landAt = millis() + (untilTimeRender > 0 ? untilTimeRender : 0);
         }
+        strftime(timeBuff, DISPLAY_MAX_CHARS, params.displayText, &timeInfo);
+        renderPages(params, timeBuff, params.justify);
       }
-    } else {
-      currentDisplayTextLen = justifyText(currentDisplayText, DISPLAY_MAX_CHARS, params.displayText, DISPLAY_MAX_CHARS, params.justify);
-    }
 
-    if (!params.multilineStartTime && currentDisplayTextLen > lineSize) {
-      params.multilineStartTime = millis();
-      params.multilinePos = 0;
+      time_t now = time(NULL);
+      if (status) {
+        renderPages(params, status, JustifyNone);
+        params.nextTimeRender = now + 1; // Keep trying
+      } else if (clockOnModules) {
+        // The modules move on their own, only drift needs correcting
+        params.nextTimeRender = now + DISPLAY_CLOCK_RESYNC;
+      } else {
+        // A pre-rolled render was for nextTimeRender, so it's the one after that's next
+        time_t from = landAt ? params.nextTimeRender : now;
+        params.nextTimeRender = (from / params.timeInterval + 1) * params.timeInterval;
+      }
     }
 
-    if (params.multilinePos >= currentDisplayTextLen) params.multilinePos = 0;
+    if (clockOnModules) sendClock();
 
-    LOG("Displaying: ");
-    for (unsigned int i = 0; i < lineSize; i++) {
-      LOG(currentDisplayText[params.multilinePos + i]);
-    }
-    LOGLN();
-
-    motorMoveToFlap(charToFlap(currentDisplayText[params.multilinePos]));
-
-    for (unsigned int i = 0; i < nKnownModules; i++) {
-      unsigned char res;
-      unsigned char nRetries = 5;
-      unsigned int curIdx = params.multilinePos + i + 1;
-      char curChar = curIdx < currentDisplayTextLen ? currentDisplayText[curIdx] : ' ';
-      char buff[6];
-      snprintf(buff, 6, "f %d", charToFlap(curChar));
-      do {
-        Wire.beginTransmission(knownModules[i]);
-        Wire.write(buff);
-        Wire.write(0);
-        res = Wire.endTransmission();
-        delayMicroseconds(500); // To make it easier to see in the logic analyzer
-      } while (res != 0 && nRetries--);
+    if (params.scroll) {
+      // The page is the window onto the strip at the current offset, multilinePage
+      unsigned char window[DISPLAY_MAX_CELLS];
+      params.multilinePage %= params.scrollWidth;
+      for (unsigned int cell = 0; cell < pageSize; cell++) {
+        unsigned int row = cell / layout.cols;
+        unsigned int col = (params.multilinePage + cell % layout.cols) % params.scrollWidth;
+        window[cell] = params.pageFlaps[row * params.scrollWidth + col];
+      }
+      sendPage(window, params.transition);
+    } else if (params.storedPath) {
+      if (params.multilinePage != params.storedPage) renderStoredPage(params, false);
+
+      sendPage(params.pageFlaps, params.transition);
+    } else {
+      if (params.multilinePage >= params.nPages) params.multilinePage = 0;
+
+      sendPage(&params.pageFlaps[params.multilinePage * pageSize], params.transition, landAt);
     }
 
     displayDirty = false;
   }
-  lastSeconds = curSeconds;
 }
 
-void displayMessage(const char* message, unsigned int len, unsigned int seconds, bool time, DisplayJustify justify) {
-  auto &params = seconds ? ephemeralDisplayParams : persistentDisplayParams;
-  
-  params.isTime = time;
-  params.justify = justify;
-  strncpy(params.displayText, message, DISPLAY_MAX_CHARS);
-  
-  // Clear ephemeral message either way
-  lastEphemeralDisplayMillis = millis();
-  ephemeralDisplayDurationMillis = seconds * 1000;
-
-  // These need to be derived from the final display string which happens in displayEvents
-  params.multilineStartTime = params.multilinePos = 0;
+void displayMessage(const char* message, unsigned int len, unsigned int seconds, bool time, DisplayJustify justify, DisplayTransition transition, unsigned int scroll) {
+  auto &pending = seconds ? pendingEphemeral : pendingPersistent;
+
+  displayStats.messages++;
+  if (pending.pending) displayStats.coalesced++;
+
+  strncpy(pending.text, message, DISPLAY_MAX_CHARS);
+  pending.text[DISPLAY_MAX_CHARS] = '\0';
+  pending.seconds = seconds;
+  pending.isTime = time;
+  pending.justify = justify;
+  pending.transition = transition;
+  pending.scroll = scroll;
+  pending.stored = false;
+  pending.nFlaps = 0;
+  pending.pending = true;
+
+  // A persistent message clears the ephemeral one, so one still waiting would never be seen
+  if (!seconds && pendingEphemeral.pending) {
+    pendingEphemeral.pending = false;
+    displayStats.coalesced++;
+  }
 
   // Nothing happens until the next loop(), see displayEvents()
-  displayDirty = true;
+}
+
+void displayStoredMessage(unsigned int seconds, DisplayJustify justify, DisplayTransition transition) {
+  // Replaces one still waiting, same as displayMessage()
+  LittleFS.rename(MESSAGE_UPLOAD_PATH, seconds ? MESSAGE_EPHEMERAL_PENDING_PATH : MESSAGE_PENDING_PATH);
+
+  displayMessage("", 0, seconds, false, justify, transition);
+  (seconds ? pendingEphemeral : pendingPersistent).stored = true;
+}
+
+void displayFlaps(const unsigned char* flaps, unsigned int n, unsigned int seconds, DisplayTransition transition) {
+  static_assert(sizeof(PendingMessage::text) >= DISPLAY_MAX_CELLS, "A frame of flaps should fit a pending message");
+
+  if (n > DISPLAY_MAX_CELLS) n = DISPLAY_MAX_CELLS;
+
+  // Replaces one still waiting, same as displayMessage(). No flaps at all is just a blank message.
+  displayMessage("", 0, seconds, false, JustifyNone, transition);
+  if (!n) return;
+
+  auto &pending = seconds ? pendingEphemeral : pendingPersistent;
+  memcpy(pending.text, flaps, n);
+  pending.nFlaps = n;
+}
+
+bool displaySettled() {
+  return !framePending && !confirmAt;
+}
+
+unsigned long displayEta() {
+  long remaining = frameEta - millis();
+  return remaining > 0 ? remaining : 0;
+}
+
+unsigned int displayShownText(char* buff, unsigned int buffLen) {
+  unsigned int len = 0;
+
+  if (!buffLen) return 0;
+
+  // Room for a separator and the longest UTF-8 character
+  for (unsigned int cell = 0; cell < (unsigned int)(layout.rows * layout.cols) && len + 4 < buffLen; cell++) {
+    if (cell && cell % layout.cols == 0) buff[len++] = '|';
+
+    if (layout.cells[cell] == DISPLAY_CELL_EMPTY) {
+      buff[len++] = ' ';
+    } else {
+      unsigned int charLen = charmapFlapToUtf8(shadow[cell].confirmed, &buff[len]);
+      if (!charLen) buff[len++] = '_';
+      len += charLen;
+    }
+  }
+  buff[len] = '\0';
+
+  return len;
+}
+
+void displayInvalidate() {
+  layout.dirty = true;
+}
+
+bool displaySetLayout(unsigned char rows, unsigned char cols) {
+  if (rows * cols > DISPLAY_MAX_CELLS) return false;
+
+  if (!rows || !cols) {
+    Config.displayRows = Config.displayCols = 0;
+  } else {
+    // Start out in enumeration order, same as the single row layout
+    Config.displayRows = rows;
+    Config.displayCols = cols;
+    memset(Config.displayLayout, DISPLAY_CELL_EMPTY, sizeof(Config.displayLayout));
+    Config.displayLayout[0] = DISPLAY_CELL_MASTER;
+    for (unsigned int i = 0; i < nKnownModules && i + 1 < (unsigned int)(rows * cols); i++) {
+      Config.displayLayout[i + 1] = knownModules[i];
+    }
+  }
+
+  layout.dirty = true;
+  return true;
+}
+
+bool displaySetLayoutCell(unsigned char cell, unsigned char addr) {
+  if (!Config.displayRows || cell >= Config.displayRows * Config.displayCols) return false;
+
+  Config.displayLayout[cell] = addr;
+  layout.dirty = true;
+  return true;
 }
 
 void displaySetTimeZone(const char* timezone) {
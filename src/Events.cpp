@@ -0,0 +1,188 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+#include "Communication.h"
+#include "Display.h"
+#include "Events.h"
+#include "Motor.h"
+#include "Mqtt.h"
+
+#include "Config.h"
+
+// Browsers on /events, and the MQTT broker. Each is sent what changed since it was last able to take something.
+enum EventSink {
+  SinkBrowsers,
+  SinkMqtt,
+  EVENT_SINKS
+};
+
+#define EVENT_ALL_SINKS ((1 << EVENT_SINKS) - 1)
+
+static AsyncEventSource* events = NULL;
+static unsigned long lastCheck = 0;
+
+// Last sent, or to be sent, of everything clients are told about
+static struct DisplayState {
+  char text[DISPLAY_MAX_CELLS * 4 + 1];
+  bool settled;
+  bool dirty;
+} displays[EVENT_SINKS];
+
+// The master first, then knownModules in order
+static struct ModuleState {
+  Status status;
+  unsigned char flap;
+  unsigned char dirty; // Bit per sink
+} modules[DISPLAY_MAX_CELLS];
+
+static const char* motorEvent = NULL;
+static unsigned char motorDirty = 0;
+static bool commandOk = false;
+static unsigned char commandDirty = 0;
+
+static int moduleIndex(unsigned char addr) {
+  for (unsigned int i = 0; i < nKnownModules; i++) {
+    if (knownModules[i] == addr) return i + 1;
+  }
+  return -1;
+}
+
+// The topic for MQTT, which is the event name unless it's about one thing of many. Retained events are state
+// rather than things that happened, so a new subscriber gets the latest. They go under state/, away from the
+// topics the wall subscribes to, or it would be sent its own state back.
+static bool send(EventSink sink, JsonDocument& doc, const char* event, const char* topic = NULL, bool retain = true) {
+  char buff[EVENTS_MESSAGE_SIZE];
+  serializeJson(doc, buff, sizeof(buff));
+
+  if (sink == SinkBrowsers) {
+    events->send(buff, event, millis());
+    return true;
+  }
+
+  char fullTopic[32];
+  snprintf(fullTopic, sizeof(fullTopic), retain ? "state/%s" : "%s", topic ? topic : event);
+  return mqttPublish(fullTopic, buff, retain);
+}
+
+static bool sinkReady(EventSink sink) {
+  if (sink == SinkMqtt) return mqttConnected();
+
+  if (!events || !events->count()) return false;
+  // Clients are behind, what's changed will go out once they've caught up, by which time it may have changed again
+  return events->avgPacketsWaiting() <= EVENTS_MAX_WAITING;
+}
+
+static void eventsResync(EventSink sink) {
+  displays[sink].dirty = true;
+  for (unsigned int i = 0; i <= nKnownModules; i++) modules[i].dirty |= 1 << sink;
+}
+
+void eventsInit(AsyncWebServer* server) {
+  events = new AsyncEventSource("/events");
+
+  // Everyone starts out with the whole picture
+  events->onConnect([] (AsyncEventSourceClient* client) {
+    eventsResync(SinkBrowsers);
+  });
+
+  server->addHandler(events);
+}
+
+void eventsMqttConnected() {
+  eventsResync(SinkMqtt);
+}
+
+void eventsModuleStatus(unsigned char addr, Status status, unsigned char flap) {
+  int i = addr == DISPLAY_CELL_MASTER ? 0 : moduleIndex(addr);
+  if (i < 0) return;
+
+  if (modules[i].status != status || modules[i].flap != flap) modules[i].dirty = EVENT_ALL_SINKS;
+  modules[i].status = status;
+  modules[i].flap = flap;
+}
+
+void eventsMotor(const char* event) {
+  motorEvent = event;
+  motorDirty = EVENT_ALL_SINKS;
+}
+
+void eventsCommandFinished(bool ok) {
+  commandOk = ok;
+  commandDirty = EVENT_ALL_SINKS;
+}
+
+static void sendDisplay(EventSink sink, const char* shownText, bool settled) {
+  DisplayState& display = displays[sink];
+  if (!display.dirty && display.settled == settled && !strcmp(shownText, display.text)) return;
+
+  StaticJsonDocument<EVENTS_MESSAGE_SIZE> doc;
+  doc["text"] = shownText;
+  doc["settled"] = settled;
+  doc["eta"] = displayEta();
+  if (!send(sink, doc, "display")) return;
+
+  strcpy(display.text, shownText);
+  display.settled = settled;
+  display.dirty = false;
+}
+
+static void sendModules(EventSink sink) {
+  for (unsigned int i = 0; i <= nKnownModules; i++) {
+    if (!(modules[i].dirty & (1 << sink))) continue;
+
+    StaticJsonDocument<EVENTS_MESSAGE_SIZE> doc;
+    char topic[16];
+    if (i) {
+      doc["address"] = knownModules[i - 1];
+      snprintf(topic, sizeof(topic), "module/%u", (unsigned int)knownModules[i - 1]);
+    } else {
+      doc["address"] = "master";
+      strcpy(topic, "module/master");
+    }
+    doc["status"] = StatusStr[modules[i].status];
+    doc["flapNumber"] = modules[i].flap;
+    if (!send(sink, doc, "module", topic)) return;
+    modules[i].dirty &= ~(1 << sink);
+  }
+}
+
+void eventsLoop() {
+  if (millis() - lastCheck < EVENTS_INTERVAL) return;
+  lastCheck = millis();
+
+  bool ready[EVENT_SINKS];
+  bool anyReady = false;
+  for (unsigned int sink = 0; sink < EVENT_SINKS; sink++) {
+    ready[sink] = sinkReady((EventSink)sink);
+    anyReady |= ready[sink];
+  }
+  if (!anyReady) return;
+
+  // The master's own status costs nothing to check
+  eventsModuleStatus(DISPLAY_CELL_MASTER, deviceLastStatus, motorCurrentFlap());
+
+  char shownText[sizeof(displays[0].text)];
+  displayShownText(shownText, sizeof(shownText));
+  bool settled = displaySettled();
+
+  for (unsigned int i = 0; i < EVENT_SINKS; i++) {
+    if (!ready[i]) continue;
+    EventSink sink = (EventSink)i;
+
+    sendDisplay(sink, shownText, settled);
+    sendModules(sink);
+
+    if (motorDirty & (1 << sink)) {
+      StaticJsonDocument<EVENTS_MESSAGE_SIZE> doc;
+      doc["event"] = motorEvent;
+      if (send(sink, doc, "motor", NULL, false)) motorDirty &= ~(1 << sink);
+    }
+
+    if (commandDirty & (1 << sink)) {
+      StaticJsonDocument<EVENTS_MESSAGE_SIZE> doc;
+      doc["ok"] = commandOk;
+      if (send(sink, doc, "command", NULL, false)) commandDirty &= ~(1 << sink);
+    }
+  }
+}
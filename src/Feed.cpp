@@ -0,0 +1,91 @@
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#include "Display.h"
+#include "Feed.h"
+
+#include "Config.h"
+
+FeedStats feedStats = {0};
+
+static WiFiUDP udp;
+
+static bool streaming = false;
+static uint32_t lastSequence = 0;
+static unsigned long lastFrameMillis = 0;
+
+static bool inSequence(uint32_t sequence) {
+  // Compared as a difference, so the sequence can wrap around
+  int32_t ahead = (int32_t)(sequence - lastSequence);
+
+  if (streaming && millis() - lastFrameMillis < FEED_RESYNC_TIMEOUT) {
+    if (ahead <= 0) {
+      feedStats.outOfOrder++;
+      return false;
+    }
+    feedStats.lost += ahead - 1;
+  }
+
+  streaming = true;
+  lastSequence = sequence;
+  lastFrameMillis = millis();
+  return true;
+}
+
+static bool handleFrame(const unsigned char* buff, unsigned int size) {
+  if (buff[0] != FEED_VERSION) return false;
+
+  uint32_t sequence = (uint32_t)buff[1] << 24 | (uint32_t)buff[2] << 16 | (uint32_t)buff[3] << 8 | buff[4];
+  unsigned char flags = buff[5];
+  const unsigned char* payload = &buff[FEED_HEADER_SIZE];
+  unsigned int len = size - FEED_HEADER_SIZE;
+
+  if (flags & ~(FEED_FLAG_JUSTIFY | FEED_FLAG_FLAPS | FEED_FLAG_TRANSITION)) return false;
+
+  DisplayJustify justify = (DisplayJustify)(flags & FEED_FLAG_JUSTIFY);
+  DisplayTransition transition = (DisplayTransition)((flags & FEED_FLAG_TRANSITION) >> FEED_FLAG_TRANSITION_SHIFT);
+
+  if (flags & FEED_FLAG_FLAPS) {
+    if (len > DISPLAY_MAX_CELLS) return false;
+    for (unsigned int i = 0; i < len; i++) {
+      if (payload[i] >= MOTOR_FLAPS) return false;
+    }
+  }
+
+  // Only a valid frame moves the sequence on
+  if (!inSequence(sequence)) return true;
+  feedStats.frames++;
+
+  if (flags & FEED_FLAG_FLAPS) {
+    displayFlaps(payload, len, 0, transition);
+  } else {
+    char text[DISPLAY_MAX_CHARS+1];
+    memcpy(text, payload, len);
+    text[len] = '\0';
+    displayMessage(text, len, 0, false, justify, transition);
+  }
+  return true;
+}
+
+void feedInit() {
+  if (!udp.begin(FEED_PORT)) {
+    LOGLN("Failed to listen for live frames");
+    return;
+  }
+  LOG("Listening for live frames on UDP port "); LOGLN(FEED_PORT);
+}
+
+void feedEvents() {
+  unsigned char buff[FEED_HEADER_SIZE + DISPLAY_MAX_CHARS];
+
+  for (unsigned int i = 0; i < FEED_MAX_DATAGRAMS; i++) {
+    // Also drops whatever's left of the last datagram
+    int size = udp.parsePacket();
+    if (size <= 0) return;
+
+    feedStats.datagrams++;
+    if (size < FEED_HEADER_SIZE || (unsigned int)size > sizeof(buff) || udp.read(buff, size) != size || !handleFrame(buff, size)) {
+      feedStats.malformed++;
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "Justify.h"
+
+static inline bool isStop(char c) {
+  return c == ' ' || c == '\0' || c == '|';
+}
+
+unsigned int justifyText(char* dstBuff, unsigned int dstBuffLen, const char* srcBuff, unsigned int srcBuffLen, DisplayJustify justify, unsigned int lineSize, size_t* consumed) {
+  size_t srcPos = 0;
+  unsigned int dstPos = 0;
+
+  if (justify != JustifyLeft && justify != JustifyCenter && justify != JustifyRight) {
+    // Verbatim, each line consists of whatever characters there are
+    while (srcPos < srcBuffLen && srcPos < dstBuffLen && srcBuff[srcPos]) {
+      dstBuff[srcPos] = srcBuff[srcPos];
+      srcPos++;
+    }
+    if (consumed) *consumed = srcPos;
+    return srcPos;
+  }
+
+  if (!lineSize) {
+    if (consumed) *consumed = 0;
+    return 0;
+  }
+
+  while (dstPos < dstBuffLen) {
+    unsigned int width = dstBuffLen - dstPos < lineSize ? dstBuffLen - dstPos : lineSize;
+
+    while (srcPos < srcBuffLen && srcBuff[srcPos] == ' ') srcPos++;
+    if (srcPos >= srcBuffLen || !srcBuff[srcPos]) break;
+
+    // Measure how many words fit on this line, counting one space between each
+    size_t scan = srcPos;
+    unsigned int used = 0;
+    bool lineBreak = false;
+
+    while (true) {
+      while (scan < srcBuffLen && srcBuff[scan] == ' ') scan++;
+      if (scan >= srcBuffLen || !srcBuff[scan]) break;
+      if (srcBuff[scan] == '|') {
+        lineBreak = true;
+        break;
+      }
+
+      // Past the width is too long either way, so a long word isn't scanned again for each line it's split over
+      size_t wordEnd = scan;
+      size_t scanEnd = scan + width + 1 < srcBuffLen ? scan + width + 1 : srcBuffLen;
+      while (wordEnd < scanEnd && !isStop(srcBuff[wordEnd])) wordEnd++;
+      unsigned int wordSize = wordEnd - scan;
+      unsigned int needed = used ? used + 1 + wordSize : wordSize;
+
+      if (needed > width) {
+        if (!used) {
+          // Doesn't fit on a line of its own either, so split it
+          used = width;
+          scan += width;
+        }
+        break;
+      }
+
+      used = needed;
+      scan = wordEnd;
+    }
+
+    // Justification is just where the line's content starts
+    unsigned int offset = 0;
+    if (width == lineSize) {
+      if (justify == JustifyCenter) offset = (width - used) / 2;
+      else if (justify == JustifyRight) offset = width - used;
+    }
+
+    char* line = &dstBuff[dstPos];
+    memset(line, ' ', offset);
+
+    // Copy the measured words, collapsing runs of spaces into one
+    for (unsigned int n = 0; n < used; n++) {
+      if (srcBuff[srcPos] == ' ') {
+        while (srcBuff[srcPos] == ' ') srcPos++;
+        line[offset + n] = ' ';
+      } else {
+        line[offset + n] = srcBuff[srcPos++];
+      }
+    }
+
+    memset(&line[offset + used], ' ', width - offset - used);
+    dstPos += width;
+
+    srcPos = scan;
+    if (lineBreak) srcPos++;
+  }
+
+  if (consumed) *consumed = srcPos;
+  return dstPos;
+}
@@ -0,0 +1,153 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "Commands.h"
+#include "Communication.h"
+#include "Display.h"
+#include "Feed.h"
+#include "Metrics.h"
+#include "Motor.h"
+#include "Pool.h"
+
+#include "Config.h"
+
+// Upper bounds of the histogram buckets, in µs. There's one more bucket for anything longer.
+static const unsigned long bucketBounds[] = { 1000, 5000, 10000, 50000, 100000, 500000, 1000000 };
+#define METRICS_BUCKETS (sizeof(bucketBounds) / sizeof(bucketBounds[0]) + 1)
+
+struct Histogram {
+  unsigned long buckets[METRICS_BUCKETS];
+  unsigned long count;
+  unsigned long long sum; // µs
+};
+
+static Histogram loopTimes = {0};
+static Histogram httpHandlerTimes = {0};
+static unsigned long loopStart = 0;
+
+static const struct {
+  unsigned int method;
+  const char* name;
+} httpMethods[] = {
+  { HTTP_GET, "GET" },
+  { HTTP_POST, "POST" },
+  { HTTP_DELETE, "DELETE" },
+  { HTTP_PUT, "PUT" },
+  { HTTP_PATCH, "PATCH" },
+  { HTTP_HEAD, "HEAD" },
+  { HTTP_OPTIONS, "OPTIONS" },
+};
+#define METRICS_HTTP_METHODS (sizeof(httpMethods) / sizeof(httpMethods[0]))
+
+static unsigned long httpRequests[METRICS_HTTP_METHODS + 1]; // The last is any other method
+
+static void observe(Histogram& histogram, unsigned long micros) {
+  unsigned int i = 0;
+  while (i < METRICS_BUCKETS - 1 && micros > bucketBounds[i]) i++;
+  histogram.buckets[i]++;
+  histogram.count++;
+  histogram.sum += micros;
+}
+
+void metricsLoop() {
+  unsigned long now = micros();
+  if (loopStart) observe(loopTimes, now - loopStart);
+  loopStart = now;
+}
+
+void metricsHttpRequest(unsigned int method) {
+  unsigned int i = 0;
+  while (i < METRICS_HTTP_METHODS && httpMethods[i].method != method) i++;
+  httpRequests[i]++;
+}
+
+void metricsHttpHandler(unsigned long micros) {
+  observe(httpHandlerTimes, micros);
+}
+
+static void printSeconds(Print* out, unsigned long long micros) {
+  out->printf("%lu.%06lu", (unsigned long)(micros / 1000000), (unsigned long)(micros % 1000000));
+}
+
+static void printHeader(Print* out, const char* name, const char* type, const char* help) {
+  out->printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void printHistogram(Print* out, const char* name, const char* help, const Histogram& histogram) {
+  printHeader(out, name, "histogram", help);
+
+  unsigned long cumulative = 0;
+  for (unsigned int i = 0; i < METRICS_BUCKETS - 1; i++) {
+    cumulative += histogram.buckets[i];
+    out->printf("%s_bucket{le=\"", name);
+    printSeconds(out, bucketBounds[i]);
+    out->printf("\"} %lu\n", cumulative);
+  }
+  out->printf("%s_bucket{le=\"+Inf\"} %lu\n", name, histogram.count);
+  out->printf("%s_sum ", name);
+  printSeconds(out, histogram.sum);
+  out->printf("\n%s_count %lu\n", name, histogram.count);
+}
+
+static void printValue(Print* out, const char* name, const char* type, const char* help, unsigned long value) {
+  printHeader(out, name, type, help);
+  out->printf("%s %lu\n", name, value);
+}
+
+void metricsWrite(Print* out) {
+  printValue(out, "splitflap_uptime_seconds", "gauge", "Seconds since boot", millis() / 1000);
+
+  printHistogram(out, "splitflap_loop_seconds", "Time taken by each iteration of the main loop", loopTimes);
+
+  printValue(out, "splitflap_heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+  printValue(out, "splitflap_heap_max_block_bytes", "gauge", "Largest block that can be allocated", ESP.getMaxFreeBlockSize());
+  printValue(out, "splitflap_heap_fragmentation_percent", "gauge", "Heap fragmentation", ESP.getHeapFragmentation());
+
+  printHeader(out, "splitflap_pool_blocks", "gauge", "Blocks in each size class of the buffer pool");
+  for (unsigned int i = 0; i < poolClasses(); i++) {
+    out->printf("splitflap_pool_blocks{size=\"%u\"} %u\n", (unsigned int)poolStats(i).blockSize, poolStats(i).blocks);
+  }
+  printHeader(out, "splitflap_pool_used_blocks", "gauge", "Blocks in use");
+  for (unsigned int i = 0; i < poolClasses(); i++) {
+    out->printf("splitflap_pool_used_blocks{size=\"%u\"} %u\n", (unsigned int)poolStats(i).blockSize, poolStats(i).used);
+  }
+  printHeader(out, "splitflap_pool_high_water_blocks", "gauge", "Most blocks ever in use at once");
+  for (unsigned int i = 0; i < poolClasses(); i++) {
+    out->printf("splitflap_pool_high_water_blocks{size=\"%u\"} %u\n", (unsigned int)poolStats(i).blockSize, poolStats(i).highWater);
+  }
+  printHeader(out, "splitflap_pool_failures_total", "counter", "Allocations that found every block big enough in use");
+  for (unsigned int i = 0; i < poolClasses(); i++) {
+    out->printf("splitflap_pool_failures_total{size=\"%u\"} %lu\n", (unsigned int)poolStats(i).blockSize, poolStats(i).failures);
+  }
+  printValue(out, "splitflap_pool_oversized_total", "counter", "Allocations bigger than any block", poolOversized());
+
+  printValue(out, "splitflap_i2c_reads_total", "counter", "I2C reads, counting each attempt", i2cStats.reads);
+  printValue(out, "splitflap_i2c_writes_total", "counter", "I2C writes, counting each attempt", i2cStats.writes);
+  printValue(out, "splitflap_i2c_retries_total", "counter", "I2C attempts after the first", i2cStats.retries);
+  printValue(out, "splitflap_i2c_errors_total", "counter", "I2C reads and writes that failed every attempt", i2cStats.errors);
+
+  printValue(out, "splitflap_motor_moves_total", "counter", "Moves of the master's motor", motorStats.moves);
+  printValue(out, "splitflap_motor_stalls_total", "counter", "Stalls of the master's motor", motorStats.stalls);
+
+  printValue(out, "splitflap_display_messages_total", "counter", "Messages sent to the display", displayStats.messages);
+  printValue(out, "splitflap_display_coalesced_total", "counter", "Messages replaced before they were shown", displayStats.coalesced);
+  printValue(out, "splitflap_display_frames_total", "counter", "Frames that changed at least one module", displayStats.frames);
+
+  printValue(out, "splitflap_feed_datagrams_total", "counter", "Datagrams received on the live frame port", feedStats.datagrams);
+  printValue(out, "splitflap_feed_frames_total", "counter", "Live frames sent on to the display", feedStats.frames);
+  printValue(out, "splitflap_feed_out_of_order_total", "counter", "Live frames dropped for not being newer than the last", feedStats.outOfOrder);
+  printValue(out, "splitflap_feed_lost_total", "counter", "Live frame sequence numbers skipped over", feedStats.lost);
+  printValue(out, "splitflap_feed_malformed_total", "counter", "Datagrams on the live frame port that weren't a frame", feedStats.malformed);
+
+  printHeader(out, "splitflap_http_requests_total", "counter", "HTTP requests by method");
+  for (unsigned int i = 0; i <= METRICS_HTTP_METHODS; i++) {
+    out->printf("splitflap_http_requests_total{method=\"%s\"} %lu\n", i < METRICS_HTTP_METHODS ? httpMethods[i].name : "OTHER", httpRequests[i]);
+  }
+  printHistogram(out, "splitflap_http_handler_seconds", "Time spent in each web handler callback", httpHandlerTimes);
+
+  printHeader(out, "splitflap_commands", "gauge", "Command queue slots by state");
+  for (unsigned int state = CommandReceiving; state <= CommandFinished; state++) {
+    out->printf("splitflap_commands{state=\"%s\"} %u\n", CommandStateStr[state], commandCount((CommandState)state));
+  }
+  printValue(out, "splitflap_commands_capacity", "gauge", "Command queue slots", COMMAND_QUEUE_SIZE);
+}
@@ -30,6 +30,8 @@ static volatile unsigned int currentFlap = MOTOR_FLAPS; // Start out of range
 volatile bool motorCalibrated = false;
 volatile bool motorStalled = false;
 
+MotorStats motorStats = {0};
+
 void IRAM_ATTR doMotorISR(void *para, void *frame) {
   if ((T1C & ((1 << TCAR) | (1 << TCIT))) == 0) TEIE &= ~TEIE1;//edge int disable
   T1I = 0;
@@ -50,6 +52,7 @@ void IRAM_ATTR doMotorISR(void *para, void *frame) {
         if (motorStep >= MOTOR_STEPS + MOTOR_STALL_STEPS) { // Done a whole rotation without seeing the hall sensor. We've stalled.
           deviceLastStatus = MODULE_STALLED;
           motorStalled = true;
+          motorStats.stalls++;
           motorRunning = motorEnabled = false;
           motorHold = 0;
           motorStep = 0;
@@ -132,6 +135,7 @@ void motorMoveToFlap(unsigned int flap) {
   }
 
   currentFlap = flap;
+  motorStats.moves++;
 
   noInterrupts();
   motorTarget = (int)((float)flap * ((float)MOTOR_STEPS / (float)MOTOR_FLAPS));
@@ -144,6 +148,15 @@ unsigned int motorCurrentFlap() {
   return currentFlap;
 }
 
+// Modules only turn forwards, so this is how long it takes to go around from one flap to the other.
+// From an unknown flap (MOTOR_FLAPS), a whole revolution.
+unsigned long motorTravelMillis(unsigned int from, unsigned int to) {
+  unsigned long rpm = Config.rpm ? Config.rpm : 1;
+  if (from >= MOTOR_FLAPS) return 60000 / rpm;
+  unsigned long flaps = (to + MOTOR_FLAPS - from) % MOTOR_FLAPS;
+  return flaps * 60000 / (rpm * MOTOR_FLAPS);
+}
+
 void motorInit() {
   disableMotorTimer();
   // Subvert the Arduino core ISR, since it disables interrupts, which messes up flash.
@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <AsyncMqttClient.h>
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+
+#include "Commands.h"
+#include "Display.h"
+#include "Events.h"
+#include "Mqtt.h"
+#include "Playlist.h"
+#include "Pool.h"
+
+#include "Config.h"
+
+static AsyncMqttClient client;
+static bool enabled = false;
+static unsigned long lastAttempt = 0;
+
+static char willTopic[MQTT_TOPIC_SIZE + sizeof("/online")];
+static char clientId[sizeof(WIFI_MDNS_HOSTNAME "-") + 8];
+
+// Text of the message arriving on the display topic, which may come in more than one piece
+static char displayBuff[DISPLAY_MAX_CHARS+1];
+static unsigned int displayLen = 0;
+
+// Set on the first write that fails, so the rest of that playlist is dropped
+static bool playlistFailed = false;
+
+// Commands sent over MQTT, whose output hasn't been published yet
+static unsigned long commandIds[COMMAND_QUEUE_SIZE];
+// Their results, once read from the output, until they've been published
+static char* results[COMMAND_QUEUE_SIZE];
+
+static const char* subtopic(const char* topic) {
+  size_t prefixLen = strlen(Config.mqttTopic);
+  if (strncmp(topic, Config.mqttTopic, prefixLen) || topic[prefixLen] != '/') return NULL;
+  return &topic[prefixLen + 1];
+}
+
+static void subscribe(const char* name) {
+  char topic[MQTT_TOPIC_SIZE + 16];
+  snprintf(topic, sizeof(topic), "%s/%s", Config.mqttTopic, name);
+  client.subscribe(topic, 0);
+}
+
+static void onDisplay(const char* payload, size_t len, size_t index, size_t total) {
+  if (index == 0) displayLen = 0;
+
+  size_t n = len < DISPLAY_MAX_CHARS - displayLen ? len : DISPLAY_MAX_CHARS - displayLen;
+  memcpy(&displayBuff[displayLen], payload, n);
+  displayLen += n;
+
+  if (index + len == total) {
+    displayBuff[displayLen] = '\0';
+    displayMessage(displayBuff, displayLen, 0, false, JustifyNone);
+  }
+}
+
+static void onPlaylist(const char* payload, size_t len, size_t index, size_t total) {
+  if (!total) {
+    playlistClear();
+    return;
+  }
+
+  if (index == 0) playlistFailed = false;
+  if (playlistFailed) return;
+
+  // Its own file, so it can't get mixed up with a playlist arriving over HTTP
+  File file = LittleFS.open(PLAYLIST_MQTT_PATH, index == 0 ? "w" : "a");
+  if (!file || file.write((const uint8_t*)payload, len) != len) {
+    LOGLN("Couldn't write playlist from MQTT");
+    playlistFailed = true;
+    file.close();
+    LittleFS.remove(PLAYLIST_MQTT_PATH);
+    return;
+  }
+  file.close();
+
+  if (index + len == total) playlistReplace(PLAYLIST_MQTT_PATH, &Serial);
+}
+
+static void onCommand(const char* payload, size_t len, size_t index, size_t total) {
+  // Commands are short enough to arrive in one piece
+  if (index != 0 || len != total) return;
+
+  unsigned long* slot = NULL;
+  for (unsigned long& id : commandIds) {
+    if (!id) slot = &id;
+  }
+
+  QueuedCommand* command = slot ? commandReserve(&client) : NULL;
+  if (!command) {
+    mqttPublish("cmd/result", "{\"succeeded\":false,\"output\":\"Command queue full\"}", false);
+    return;
+  }
+  if (!commandAppend(command, (const uint8_t*)payload, len)) {
+    commandRelease(command);
+    mqttPublish("cmd/result", "{\"succeeded\":false,\"output\":\"Command longer than 255\"}", false);
+    return;
+  }
+  commandSubmit(command);
+  *slot = command->id;
+}
+
+static void onMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
+  const char* name = subtopic(topic);
+  if (!name) return;
+
+  if (!strcmp(name, "display")) onDisplay(payload, len, index, total);
+  else if (!strcmp(name, "playlist")) onPlaylist(payload, len, index, total);
+  else if (!strcmp(name, "cmd")) onCommand(payload, len, index, total);
+}
+
+void mqttInit() {
+  client.onConnect([] (bool sessionPresent) {
+    LOGLN("Connected to MQTT broker");
+    subscribe("display");
+    subscribe("playlist");
+    subscribe("cmd");
+    mqttPublish("online", "1", true);
+    eventsMqttConnected();
+  });
+
+  client.onDisconnect([] (AsyncMqttClientDisconnectReason reason) {
+    LOG("Disconnected from MQTT broker: "); LOGLN((int)reason);
+  });
+
+  client.onMessage(onMessage);
+  // Walls sharing a broker would otherwise keep disconnecting each other
+  snprintf(clientId, sizeof(clientId), WIFI_MDNS_HOSTNAME "-%06x", ESP.getChipId());
+  client.setClientId(clientId);
+
+  mqttReconfigure();
+}
+
+void mqttReconfigure() {
+  client.disconnect(true);
+
+  enabled = *Config.mqttHost;
+  if (!enabled) return;
+
+  // The client keeps these pointers, they need to stay put
+  snprintf(willTopic, sizeof(willTopic), "%s/online", Config.mqttTopic);
+  client.setServer(Config.mqttHost, Config.mqttPort);
+  client.setCredentials(*Config.mqttUser ? Config.mqttUser : NULL, *Config.mqttPassword ? Config.mqttPassword : NULL);
+  client.setWill(willTopic, 0, true, "0");
+
+  // Connect on the next pass
+  lastAttempt = millis() - MQTT_RECONNECT_INTERVAL;
+}
+
+bool mqttConnected() {
+  return enabled && client.connected();
+}
+
+bool mqttPublish(const char* topic, const char* payload, bool retain) {
+  if (!mqttConnected()) return false;
+
+  char fullTopic[MQTT_TOPIC_SIZE + 40];
+  snprintf(fullTopic, sizeof(fullTopic), "%s/%s", Config.mqttTopic, topic);
+  return client.publish(fullTopic, 0, retain, payload);
+}
+
+// Builds the result of a finished command, reading its output. Returns NULL if the pool is full.
+static char* formatResult(unsigned long id, QueuedCommand* command) {
+  // Both come from the pool rather than the stack, and before the output is read, so it waits if the pool is full
+  char* output = (char*)poolAlloc(COMMAND_OUTPUT_SIZE + 1);
+  char* buff = (char*)poolAlloc(POOL_LARGE_SIZE);
+  if (!output || !buff) {
+    poolFree(output);
+    poolFree(buff);
+    return NULL;
+  }
+
+  size_t outputLen = command->output->readBytes(output, COMMAND_OUTPUT_SIZE);
+  output[outputLen] = '\0';
+
+  StaticJsonDocument<128> doc;
+  doc["id"] = id;
+  doc["succeeded"] = command->succeeded;
+  doc["output"] = (const char*)output;
+
+  // Escaping can make the output too long for the buffer, in which case its end is cut off, and marked as such.
+  // Every character dropped shortens it by at least a byte.
+  size_t len = measureJson(doc);
+  while (len >= POOL_LARGE_SIZE) {
+    size_t excess = len - POOL_LARGE_SIZE + 1 + sizeof(",\"truncated\":true");
+    outputLen = excess < outputLen ? outputLen - excess : 0;
+    while (outputLen && (output[outputLen] & 0xC0) == 0x80) outputLen--;
+    output[outputLen] = '\0';
+    doc["truncated"] = true;
+    len = measureJson(doc);
+  }
+  serializeJson(doc, buff, POOL_LARGE_SIZE);
+
+  poolFree(output);
+  return buff;
+}
+
+static void publishResults() {
+  for (unsigned int i = 0; i < COMMAND_QUEUE_SIZE; i++) {
+    unsigned long& id = commandIds[i];
+    char*& result = results[i];
+    if (!id) continue;
+
+    QueuedCommand* command = commandFind(id);
+    if (!command) {
+      poolFree(result);
+      result = NULL;
+      id = 0;
+      continue;
+    }
+    if (command->state != CommandFinished) continue;
+
+    // Reading the output empties it, so the result is kept until it's been sent
+    if (!result) result = formatResult(id, command);
+    if (!result || !mqttPublish("cmd/result", result, false)) return;
+
+    poolFree(result);
+    result = NULL;
+    commandRelease(command);
+    id = 0;
+  }
+}
+
+void mqttEvents() {
+  if (!enabled) return;
+
+  if (client.connected()) {
+    publishResults();
+    return;
+  }
+
+  // connect() only starts connecting, it's finished by the time the next attempt comes around
+  if (WiFi.status() != WL_CONNECTED || millis() - lastAttempt < MQTT_RECONNECT_INTERVAL) return;
+  lastAttempt = millis();
+  client.connect();
+}
@@ -0,0 +1,251 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include <time.h>
+
+#include "Display.h"
+#include "Playlist.h"
+#include "TimeService.h"
+
+#include "Config.h"
+
+#define PLAYLIST_ALL_DAYS 0x7F
+
+struct PlaylistEntry {
+  char text[DISPLAY_MAX_CHARS+1];
+  unsigned int duration; // seconds
+  int priority; // Higher priority entries take over from lower ones while their window is open
+  bool isTime;
+  DisplayJustify justify;
+  DisplayTransition transition;
+  unsigned int scroll; // Characters per step, 0 to page
+  unsigned char days; // Bit per weekday, Sunday first, as in cron
+  unsigned short from; // Minutes past midnight. to < from wraps past midnight, from == to is all day.
+  unsigned short to;
+};
+
+static PlaylistEntry entries[PLAYLIST_MAX_ENTRIES];
+static unsigned int nEntries = 0;
+static int current = -1;
+static unsigned long currentStart = 0;
+static unsigned long lastCheck = 0;
+
+static bool parseClock(const char* str, unsigned short* minutes) {
+  unsigned int hours, mins;
+  if (sscanf(str, "%u:%u", &hours, &mins) != 2 || hours > 24 || mins > 59 || hours * 60 + mins > 24 * 60) return false;
+  *minutes = (hours * 60 + mins) % (24 * 60);
+  return true;
+}
+
+static bool parseEntry(JsonObjectConst obj, PlaylistEntry& entry, Print* out) {
+  const char* text = obj["text"];
+  if (!text) {
+    out->print("Entry has no text\n");
+    return false;
+  }
+  strncpy(entry.text, text, DISPLAY_MAX_CHARS);
+  entry.text[DISPLAY_MAX_CHARS] = '\0';
+
+  entry.duration = obj["duration"] | 10;
+  entry.priority = obj["priority"] | 0;
+  entry.isTime = obj["time"] | false;
+
+  // Same range as the msg command
+  int scroll = obj["scroll"] | -1;
+  if (obj["scroll"].isNull()) scroll = 0;
+  if (scroll < 0 || scroll > DISPLAY_MAX_CELLS) {
+    out->printf("Scroll should be 0-%u characters per step\n", DISPLAY_MAX_CELLS);
+    return false;
+  }
+  entry.scroll = scroll;
+
+  const char* justify = obj["justify"] | "left";
+  if (!strcmp(justify, "none")) entry.justify = JustifyNone;
+  else if (!strcmp(justify, "left")) entry.justify = JustifyLeft;
+  else if (!strcmp(justify, "center")) entry.justify = JustifyCenter;
+  else if (!strcmp(justify, "right")) entry.justify = JustifyRight;
+  else {
+    out->printf("Unknown justify \"%s\"\n", justify);
+    return false;
+  }
+
+  const char* transition = obj["transition"] | "all";
+  if (!strcmp(transition, "all")) entry.transition = TransitionAll;
+  else if (!strcmp(transition, "cascade")) entry.transition = TransitionCascade;
+  else if (!strcmp(transition, "ripple")) entry.transition = TransitionRipple;
+  else if (!strcmp(transition, "sparkle")) entry.transition = TransitionSparkle;
+  else {
+    out->printf("Unknown transition \"%s\"\n", transition);
+    return false;
+  }
+
+  entry.days = PLAYLIST_ALL_DAYS;
+  if (obj.containsKey("days")) {
+    if (!obj["days"].is<JsonArrayConst>()) {
+      out->print("Days should be an array\n");
+      return false;
+    }
+    entry.days = 0;
+    for (JsonVariantConst day : obj["days"].as<JsonArrayConst>()) {
+      int d = day | -1;
+      if (d < 0 || d > 6) {
+        out->print("Days should be 0-6, Sunday first\n");
+        return false;
+      }
+      entry.days |= 1 << d;
+    }
+  }
+
+  entry.from = entry.to = 0;
+  if (obj.containsKey("from") || obj.containsKey("to")) {
+    if (!parseClock(obj["from"] | "", &entry.from) || !parseClock(obj["to"] | "", &entry.to)) {
+      out->print("From and to should both be HH:MM\n");
+      return false;
+    }
+  }
+
+  if (!entry.duration) {
+    out->print("Duration should be at least a second\n");
+    return false;
+  }
+
+  return true;
+}
+
+// Reads the entries one at a time, so the whole document never has to be in memory
+static bool playlistLoad(const char* path, Print* out) {
+  nEntries = 0;
+  current = -1;
+
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    out->printf("Couldn't open %s\n", path);
+    return false;
+  }
+
+  if (!file.find("[")) {
+    out->print("Playlist should be an array of entries\n");
+    return false;
+  }
+
+  while (isspace(file.peek())) file.read();
+  if (file.peek() == ']') return true;
+
+  do {
+    StaticJsonDocument<PLAYLIST_ENTRY_JSON_SIZE> doc;
+    DeserializationError err = deserializeJson(doc, file);
+    if (err) {
+      out->printf("Entry %u: %s\n", nEntries, err.c_str());
+      nEntries = 0;
+      return false;
+    }
+    if (nEntries >= PLAYLIST_MAX_ENTRIES) {
+      out->print("Too many entries (max " DEFTOLIT(PLAYLIST_MAX_ENTRIES) ")\n");
+      nEntries = 0;
+      return false;
+    }
+    if (!parseEntry(doc.as<JsonObjectConst>(), entries[nEntries], out)) {
+      out->printf("Entry %u is invalid\n", nEntries);
+      nEntries = 0;
+      return false;
+    }
+    nEntries++;
+  } while (file.findUntil(",", "]"));
+
+  return true;
+}
+
+void playlistInit() {
+  if (!LittleFS.exists(PLAYLIST_PATH)) return;
+
+  if (playlistLoad(PLAYLIST_PATH, &Serial)) {
+    LOG("Loaded playlist with "); LOG(nEntries); LOGLN(" entries");
+  }
+}
+
+bool playlistReplace(const char* path, Print* out) {
+  if (!playlistLoad(path, out)) {
+    LittleFS.remove(path);
+    // Back to the one we had
+    if (LittleFS.exists(PLAYLIST_PATH)) playlistLoad(PLAYLIST_PATH, out);
+    return false;
+  }
+
+  // Rename replaces the old file atomically, so a power cut leaves one playlist or the other
+  if (!LittleFS.rename(path, PLAYLIST_PATH)) {
+    out->print("Couldn't save playlist\n");
+    return false;
+  }
+
+  out->printf("Loaded playlist with %u entries\n", nEntries);
+  return true;
+}
+
+void playlistClear() {
+  LittleFS.remove(PLAYLIST_PATH);
+  nEntries = 0;
+  current = -1;
+}
+
+static bool entryActive(const PlaylistEntry& entry, const tm* now) {
+  if (entry.days == PLAYLIST_ALL_DAYS && entry.from == entry.to) return true;
+
+  // Windowed entries wait for the time to be known
+  if (!now) return false;
+
+  if (!(entry.days & (1 << now->tm_wday))) return false;
+  if (entry.from == entry.to) return true;
+
+  unsigned int minute = now->tm_hour * 60 + now->tm_min;
+  if (entry.from < entry.to) {
+    return minute >= entry.from && minute < entry.to;
+  } else {
+    return minute >= entry.from || minute < entry.to;
+  }
+}
+
+void playlistEvents() {
+  if (!nEntries) return;
+
+  unsigned long now = millis();
+  bool expired = current < 0 || now - currentStart >= entries[current].duration * 1000UL;
+
+  // Between entries, only look for windows opening or closing every so often
+  if (!expired && now - lastCheck < PLAYLIST_CHECK_INTERVAL) return;
+  lastCheck = now;
+
+  // Before the first NTP sync windows can't be evaluated
+  tm timeInfo;
+  const tm* localTime = timeNow(&timeInfo) ? &timeInfo : NULL;
+
+  bool active[PLAYLIST_MAX_ENTRIES];
+  int maxPriority = INT_MIN;
+  for (unsigned int i = 0; i < nEntries; i++) {
+    active[i] = entryActive(entries[i], localTime);
+    if (active[i] && entries[i].priority > maxPriority) maxPriority = entries[i].priority;
+  }
+
+  // Nothing to show right now, leave the display as it is
+  if (maxPriority == INT_MIN) {
+    current = -1;
+    return;
+  }
+
+  if (!expired && active[current] && entries[current].priority == maxPriority) return;
+
+  // Round robin through the highest priority entries that are open
+  for (unsigned int n = 1; n <= nEntries; n++) {
+    unsigned int i = (current + n) % nEntries;
+    if (!active[i] || entries[i].priority != maxPriority) continue;
+
+    // Don't restart a message that's already up, it may be paging
+    if ((int)i != current) {
+      const PlaylistEntry& entry = entries[i];
+      displayMessage(entry.text, strlen(entry.text), 0, entry.isTime, entry.justify, entry.transition, entry.scroll);
+    }
+    current = i;
+    currentStart = now;
+    return;
+  }
+}
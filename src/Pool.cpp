@@ -0,0 +1,80 @@
+#include <Arduino.h>
+
+#include "Pool.h"
+
+#include "Config.h"
+
+struct PoolClass {
+  size_t blockSize;
+  unsigned int blocks;
+  char* storage;
+  unsigned long freeMask; // Bit per block, set when it's free
+  unsigned int used;
+  unsigned int highWater;
+  unsigned long failures;
+};
+
+static char smallStorage[POOL_SMALL_SIZE * POOL_SMALL_COUNT] __attribute__((aligned(8)));
+static char mediumStorage[POOL_MEDIUM_SIZE * POOL_MEDIUM_COUNT] __attribute__((aligned(8)));
+static char largeStorage[POOL_LARGE_SIZE * POOL_LARGE_COUNT] __attribute__((aligned(8)));
+
+static PoolClass classes[] = {
+  { POOL_SMALL_SIZE, POOL_SMALL_COUNT, smallStorage, (1UL << POOL_SMALL_COUNT) - 1, 0, 0, 0 },
+  { POOL_MEDIUM_SIZE, POOL_MEDIUM_COUNT, mediumStorage, (1UL << POOL_MEDIUM_COUNT) - 1, 0, 0, 0 },
+  { POOL_LARGE_SIZE, POOL_LARGE_COUNT, largeStorage, (1UL << POOL_LARGE_COUNT) - 1, 0, 0, 0 },
+};
+#define POOL_CLASSES (sizeof(classes) / sizeof(classes[0]))
+
+static_assert(POOL_SMALL_COUNT < 32 && POOL_MEDIUM_COUNT < 32 && POOL_LARGE_COUNT < 32, "Each class is tracked in a 32 bit mask");
+static_assert(POOL_SMALL_SIZE % 8 == 0 && POOL_MEDIUM_SIZE % 8 == 0 && POOL_LARGE_SIZE % 8 == 0, "Blocks should keep 8 byte alignment");
+
+static unsigned long oversized = 0;
+
+void* poolAlloc(size_t size) {
+  int fits = -1;
+  for (unsigned int i = 0; i < POOL_CLASSES; i++) {
+    PoolClass& c = classes[i];
+    if (c.blockSize < size) continue;
+    if (fits < 0) fits = i;
+    if (!c.freeMask) continue;
+
+    unsigned int block = __builtin_ctzl(c.freeMask);
+    c.freeMask &= ~(1UL << block);
+    if (++c.used > c.highWater) c.highWater = c.used;
+    return &c.storage[block * c.blockSize];
+  }
+
+  if (fits < 0) {
+    oversized++;
+  } else {
+    classes[fits].failures++;
+  }
+  LOG("Pool allocation of "); LOG(size); LOGLN(" bytes failed");
+  return NULL;
+}
+
+void poolFree(void* p) {
+  if (!p) return;
+
+  for (PoolClass& c : classes) {
+    if ((char*)p < c.storage || (char*)p >= c.storage + c.blockSize * c.blocks) continue;
+
+    c.freeMask |= 1UL << (((char*)p - c.storage) / c.blockSize);
+    c.used--;
+    return;
+  }
+  LOGLN("Freed a block that isn't from the pool");
+}
+
+unsigned int poolClasses() {
+  return POOL_CLASSES;
+}
+
+PoolStats poolStats(unsigned int sizeClass) {
+  const PoolClass& c = classes[sizeClass];
+  return { c.blockSize, c.blocks, c.used, c.highWater, c.failures };
+}
+
+unsigned long poolOversized() {
+  return oversized;
+}
@@ -0,0 +1,52 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+
+#include <time.h>
+
+#include "TimeService.h"
+
+#include "Config.h"
+
+static WiFiEventHandler gotIpHandler;
+static volatile bool synced = false;
+static volatile unsigned long lastSyncMillis = 0;
+
+// Runs from the SNTP client whenever it sets the clock
+static void onTimeSet() {
+  synced = true;
+  lastSyncMillis = millis();
+}
+
+static void startSntp() {
+  LOGLN("Configuring time");
+  // Doesn't wait for an answer, onTimeSet() is called when one arrives, and again on every later sync
+  configTime(Config.timeZone, TIME_NTP_SERVER);
+}
+
+void timeInit() {
+  settimeofday_cb(onTimeSet);
+
+  // Reconnects get a new request in, rather than waiting out the SNTP client's retry interval
+  gotIpHandler = WiFi.onStationModeGotIP([] (const WiFiEventStationModeGotIP& event) {
+    startSntp();
+  });
+
+  if (WiFi.isConnected()) startSntp();
+}
+
+bool timeNow(tm* timeInfo) {
+  if (!synced) return false;
+
+  time_t now = time(NULL);
+  localtime_r(&now, timeInfo);
+  return true;
+}
+
+bool timeSynced() {
+  return synced;
+}
+
+unsigned long timeSinceSync() {
+  return synced ? millis() - lastSyncMillis : 0;
+}
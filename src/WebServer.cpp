@@ -3,103 +3,327 @@
 #include <LittleFS.h>
 #include <Wire.h>
 
-#include <StreamUtils/Streams/MemoryStream.hpp>
-
+#include "Assets.h"
 #include "Commands.h"
+#include "CharMap.h"
 #include "Communication.h"
 #include "Display.h"
+#include "Events.h"
+#include "Metrics.h"
 #include "Motor.h"
+#include "Playlist.h"
+#include "Pool.h"
 #include "Streams.h"
+#include "TimeService.h"
 #include "Utils.h"
 
 #include "WebServer.h"
 
-struct StaticAllocator {
-  char* _buff;
-  size_t _pos;
-  size_t _size;
+#define STATUS_SECTION_SIZE 512 // Largest piece of /status, the top level fields or one module
+
+// Writes /status a section at a time as the response is sent: the top level fields, then each module, so its
+// size doesn't depend on how many modules there are. Modules are read as their turn comes.
+class StatusWriter {
+public:
+  StatusWriter(const String& fields) : _fields(fields.isEmpty() ? fields : "," + fields + ",") {}
+
+  size_t fill(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+      if (_pos == _len && !nextSection()) break;
+      size_t n = _len - _pos < maxLen - written ? _len - _pos : maxLen - written;
+      memcpy(buffer + written, _buff + _pos, n);
+      _pos += n;
+      written += n;
+    }
+    return written;
+  }
+
+private:
+  String _fields; // Comma separated and surrounded, so each can be found as ",name,"
+  unsigned int _section = 0;
+  char _buff[STATUS_SECTION_SIZE];
+  size_t _len = 0;
+  size_t _pos = 0;
+
+  bool wanted(const char* field) {
+    return _fields.isEmpty() || _fields.indexOf(String(",") + field + ",") >= 0;
+  }
+
+  // Renders the next section into _buff, false when there are none left
+  bool nextSection() {
+    StaticJsonDocument<STATUS_SECTION_SIZE> doc;
+    unsigned int module = _section++;
+
+    _pos = _len = 0;
+
+    if (module == 0) {
+      char shownText[DISPLAY_MAX_CELLS * 4 + 1];
+      displayShownText(shownText, sizeof(shownText));
+
+      if (wanted("health")) doc["health"] = "OK";
+      if (wanted("display")) doc["display"] = (const char*)shownText;
+      if (wanted("displayEta")) doc["displayEta"] = displayEta();
+      if (wanted("displaySettled")) doc["displaySettled"] = displaySettled();
+      if (wanted("displayUpdates")) {
+        doc["displayUpdates"]["received"] = displayStats.messages;
+        doc["displayUpdates"]["coalesced"] = displayStats.coalesced;
+        doc["displayUpdates"]["frames"] = displayStats.frames;
+      }
+      if (wanted("time")) {
+        doc["time"]["synced"] = timeSynced();
+        doc["time"]["sinceSync"] = timeSinceSync();
+      }
+
+      // Leave the object open for the modules
+      _len = serializeJson(doc, _buff, sizeof(_buff)) - 1;
+      _len += snprintf(&_buff[_len], sizeof(_buff) - _len, "%s\"modules\":[", doc.size() ? "," : "");
+      return true;
+    }
+
+    if (module == 1) {
+      // The address is always there, or modules couldn't be told apart
+      doc["address"] = "master";
+      if (wanted("multilineDelay")) doc["multilineDelay"] = Config.multilineDelay;
+      if (wanted("status")) doc["status"] = StatusStr[deviceLastStatus];
+      if (wanted("zeroOffset")) doc["zeroOffset"] = (unsigned char)Config.zeroOffset;
+      if (wanted("flapNumber")) doc["flapNumber"] = motorCurrentFlap();
+      if (wanted("version")) doc["version"] = VERSION;
+    } else if (module - 2 < nKnownModules) {
+      unsigned char addr = knownModules[module - 2];
+      doc["address"] = addr;
+      if (wanted("status")) doc["status"] = "Unknown";
+
+      ModuleStatus status;
+
+      switch (i2cReadStruct(addr, &status)) {
+        case PACKET_OK:
+          if (wanted("status")) doc["status"] = StatusStr[status.status];
+          if (wanted("zeroOffset")) doc["zeroOffset"] = status.zeroOffset;
+          if (wanted("flapNumber")) doc["flapNumber"] = status.flap;
+          if (wanted("version")) doc["version"] = status.version;
+          break;
+        case PACKET_CRC:
+          LOGLN("Module status CRC does not match");
+          break;
+        case PACKET_OVERFLOW:
+        case PACKET_UNDERFLOW:
+          LOGLN("Packet not the right length or I2C problem");
+          break;
+        default:
+          LOGLN("Unknown error reading module status");
+      }
+    } else if (module - 2 == nKnownModules) {
+      _len = snprintf(_buff, sizeof(_buff), "]}");
+      return true;
+    } else {
+      return false;
+    }
+
+    if (module > 1) _buff[_len++] = ',';
+    _len += serializeJson(doc, &_buff[_len], sizeof(_buff) - _len);
+    return true;
+  }
+};
+
+static_assert(sizeof(StatusWriter) <= POOL_LARGE_SIZE, "The status writer should fit a large pool block");
+
+// Streams a command's output as it's written, then frees it
+static void sendCommandOutput(AsyncWebServerRequest* request, QueuedCommand* command, int code) {
+  unsigned long id = command->id;
+  commandAttach(command, true);
+
+  // The content type event-stream is important to keep the browser from caching the first 1kb or so
+  AsyncWebServerResponse* resp = request->beginChunkedResponse("text/event-stream; charset=us-ascii", [command, id] (uint8_t* data, size_t len, size_t index) -> size_t {
+    if (command->id != id || command->state == CommandFree) return 0;
+    if (command->output->available()) return command->output->readBytes((char*)data, len);
+    if (command->state != CommandFinished) return RESPONSE_TRY_AGAIN;
+    return 0;
+  });
+  resp->setCode(code);
+  // Released on disconnect, since we could have a disconnect in the middle of a command, which would leave it dangling
+  request->onDisconnect([command, id] () {
+    if (command->id == id && command->state != CommandFree) commandRelease(command);
+  });
+  request->send(resp);
+}
+
+// Each /display upload short enough to be shown from memory is put together in its own buffer from the pool, so
+// uploads that overlap don't mix. Released when the message is shown, or the client goes away.
+struct DisplayUpload {
+  const AsyncWebServerRequest* owner;
+  unsigned int len;
+  char buff[DISPLAY_MAX_CHARS+1];
+};
+
+static_assert(sizeof(DisplayUpload) <= POOL_MEDIUM_SIZE, "Display uploads should fit a medium pool block");
+
+static DisplayUpload* displayUploads[DISPLAY_UPLOAD_POOL_SIZE];
+static const AsyncWebServerRequest* storedUploader = NULL; // Writing MESSAGE_UPLOAD_PATH
+static const AsyncWebServerRequest* playlistUploader = NULL; // Writing PLAYLIST_UPLOAD_PATH
+static const AsyncWebServerRequest* charmapUploader = NULL; // Writing CHARMAP_UPLOAD_PATH
+
+static void displayUploadRelease(DisplayUpload* upload) {
+  for (DisplayUpload*& slot : displayUploads) {
+    if (slot == upload) slot = NULL;
+  }
+  poolDelete(upload);
+}
+
+static DisplayUpload* displayUploadFind(const AsyncWebServerRequest* request) {
+  for (DisplayUpload* upload : displayUploads) {
+    if (upload && upload->owner == request) return upload;
+  }
+  return NULL;
+}
+
+static DisplayUpload* displayUploadReserve(AsyncWebServerRequest* request) {
+  for (DisplayUpload*& slot : displayUploads) {
+    if (slot) continue;
 
-  StaticAllocator(char* buff, size_t size) {
-    _buff = buff;
-    _pos = 0;
-    _size = size;
+    DisplayUpload* upload = poolNew<DisplayUpload>();
+    if (!upload) return NULL;
+
+    upload->owner = request;
+    upload->len = 0;
+    slot = upload;
+    request->onDisconnect([upload, request] () {
+      if (displayUploadFind(request) == upload) displayUploadRelease(upload);
+    });
+    return upload;
   }
+  return NULL;
+}
 
-  void* allocate(size_t n) {
-    if (_pos + n > _size) return 0;
-    char* ret = _buff+_pos;
-    _pos += n;
-    return ret;
+static void sendBusy(AsyncWebServerRequest* request, const char* reason) {
+  AsyncWebServerResponse* resp = request->beginResponse(503, "text/plain", reason);
+  resp->addHeader("Retry-After", "1");
+  request->send(resp);
+}
+
+// Writes a request's body to path as it arrives, and returns true once it's all there. There's one file, so one
+// upload at a time, the request writing it kept in uploader. A request that's turned away, or fails to write, is
+// answered once, and the rest of its body ignored.
+static bool receiveUpload(AsyncWebServerRequest* request, const AsyncWebServerRequest** uploader, const char* path, const char* what, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (index == 0) {
+    if (*uploader) {
+      sendBusy(request, "Another upload is arriving");
+      return false;
+    }
+    *uploader = request;
+    request->onDisconnect([request, uploader] () {
+      if (*uploader == request) *uploader = NULL;
+    });
+    request->_tempFile = LittleFS.open(path, "w");
+  } else if (*uploader != request || !request->_tempFile) {
+    // Already answered
+    return false;
   }
 
-  void deallocate(void* p) {
+  if (!request->_tempFile || request->_tempFile.write(data, len) != len) {
+    request->_tempFile.close();
+    LittleFS.remove(path);
+    *uploader = NULL;
+    request->send(500, "text/plain", String("Couldn't write ") + what);
+    return false;
+  }
+
+  if (index + len < total) return false;
+
+  request->_tempFile.close();
+  *uploader = NULL;
+  return true;
+}
+
+// Counts every request as it's matched to a handler, without handling any
+class RequestCounter : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest* request) override {
+    metricsHttpRequest(request->method());
+    return false;
   }
 };
 
-// We store these buffers globally since they're so large, and cause crazy heap fragmentation, and eventual crashes.
-char cmdBuff[128]; // Async command buffer
-char memBuff[512]; // Async logging stream
-BlockingStream<StreamUtils::BasicMemoryStream<StaticAllocator>> memStream(sizeof(memBuff), StaticAllocator(memBuff, sizeof(memBuff)));
+// Handler callbacks are timed for /metrics
+template<typename... Args> static std::function<void(Args...)> timed(std::function<void(Args...)> fn) {
+  if (!fn) return fn;
+  return [fn] (Args... args) {
+    unsigned long start = micros();
+    fn(args...);
+    metricsHttpHandler(micros() - start);
+  };
+}
 
 class NoDelayWebServer : public AsyncWebServer {
 public:
   NoDelayWebServer(uint16_t port) : AsyncWebServer(port) {
     _server.setNoDelay(true);
+    addHandler(new RequestCounter());
+  }
+
+  AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr) {
+    return AsyncWebServer::on(uri, method, timed(onRequest), timed(onUpload), timed(onBody));
   }
 };
 
-AsyncWebServer* server = NULL;
+NoDelayWebServer* server = NULL;
 
 void notFound(AsyncWebServerRequest *request) {
     request->send(404, "text/plain", "Not found");
 }
 
+static DisplayJustify parseJustify(const String& justify) {
+  if (justify.isEmpty()) {
+    return JustifyNone;
+  } else if (justify == "left") {
+    return JustifyLeft;
+  } else if (justify == "right") {
+    return JustifyRight;
+  } else {
+    return JustifyCenter;
+  }
+}
+
+static DisplayTransition parseTransition(const String& transition) {
+  if (transition.isEmpty()) {
+    return TransitionAll;
+  } else if (transition == "cascade") {
+    return TransitionCascade;
+  } else if (transition == "ripple") {
+    return TransitionRipple;
+  } else {
+    return TransitionSparkle;
+  }
+}
+
+// Characters per step, in the same range as the msg command. Returns false if it's out of range.
+static bool parseScroll(const String& scroll, unsigned int* steps) {
+  unsigned long n = strtoul(scroll.c_str(), NULL, 10);
+  if (scroll.length() > 3 || n > DISPLAY_MAX_CELLS) return false;
+  *steps = n;
+  return true;
+}
+
 void WebServerInit() {
   server = new NoDelayWebServer(80);
 
+  // ?fields=status,flapNumber only includes those fields
   server->on("/status", HTTP_GET, [] (AsyncWebServerRequest *request) {
-      // So JsonArduino doesn't allow just-in-time serialization... this is a limiting factor in 
-      // how many modules, or what status we can represent
-      StaticJsonDocument<1024> doc;
-
-      doc["health"] = "OK";
-
-      doc["modules"][0]["address"] = "master";
-      doc["modules"][0]["multilineDelay"] = Config.multilineDelay;
-      doc["modules"][0]["status"] = StatusStr[deviceLastStatus];
-      doc["modules"][0]["zeroOffset"] = (unsigned char)Config.zeroOffset;
-      doc["modules"][0]["flapNumber"] = motorCurrentFlap();
-      doc["modules"][0]["version"] = VERSION;
-
-      for (int i = 0; i < nKnownModules; i++) {
-        doc["modules"][i+1]["address"] = knownModules[i];
-        doc["modules"][i+1]["status"] = "Unknown";
-
-        ModuleStatus status;
-
-        switch (i2cReadStruct(knownModules[i], &status)) {    
-          case PACKET_OK:
-            doc["modules"][i+1]["status"] = StatusStr[status.status];
-            doc["modules"][i+1]["zeroOffset"] = status.zeroOffset;
-            doc["modules"][i+1]["flapNumber"] = status.flap;
-            doc["modules"][i+1]["version"] = status.version;
-            break;
-          case PACKET_CRC:
-            LOGLN("Module status CRC does not match");
-            break;
-          case PACKET_OVERFLOW:
-          case PACKET_UNDERFLOW:
-            LOGLN("Packet not the right length or I2C problem");
-            break;
-          default:
-            LOGLN("Unknown error reading module status");
-        }
-      }
+    StatusWriter* writer = poolNew<StatusWriter>(request->hasParam("fields") ? request->getParam("fields")->value() : String());
+    if (!writer) {
+      sendBusy(request, "Too many status requests at once");
+      return;
+    }
+    request->onDisconnect([writer] () { poolDelete(writer); });
+    request->send(request->beginChunkedResponse("application/json", [writer] (uint8_t* buffer, size_t maxLen, size_t index) {
+      return writer->fill(buffer, maxLen);
+    }));
+  });
 
-      AsyncResponseStream* resp = request->beginResponseStream("application/json");
-      serializeJsonPretty(doc, *resp);
-      resp->setCode(200);
-      request->send(resp);
+  server->on("/metrics", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    AsyncResponseStream* resp = request->beginResponseStream("text/plain; version=0.0.4");
+    metricsWrite(resp);
+    request->send(resp);
   });
 
   server->on("/cmd", HTTP_POST, [] (AsyncWebServerRequest *request) {
@@ -112,98 +336,225 @@ void WebServerInit() {
   },
   NULL,
   [] (AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    QueuedCommand* command = index == 0 ? commandReserve(request) : commandFindOwner(request);
+    if (!command) {
+      // Later parts of a command that was turned away have nowhere to go
+      if (index == 0) {
+        sendBusy(request, "Command queue full");
+      }
+      return;
+    }
+
+    bool queue = request->hasParam("queue");
     if (index == 0) {
-      // gets deleted in the request destructor
-      memStream.flush();
+      unsigned long id = command->id;
+      // Queued commands are collected later, but not if their text never arrived
+      request->onDisconnect([command, id, queue] () {
+        if (command->id == id && command->state != CommandFree && (!queue || command->state == CommandReceiving)) commandRelease(command);
+      });
     }
 
-    if ((unsigned int)memStream.available() + len > 255) {
+    if (!commandAppend(command, data, len)) {
+      commandRelease(command);
       request->send(400, "text/plain", "Request longer than 255");
       return;
     }
 
-    memStream.write(data, len);
-
     if (index + len == total) {
-      cmdBuff[memStream.readBytes(cmdBuff, 255)] = 0;
-
-      Serial.printf("Command buff: %s\n", cmdBuff);
-
-      bool async = handleCommandAsync(cmdBuff, &memStream);
-
-      // The content type event-stream is important to keep the browser from caching the first 1kb or so
-      AsyncWebServerResponse* resp = request->beginChunkedResponse("text/event-stream; charset=us-ascii", [async, request] (uint8_t* data, size_t len, size_t index) -> size_t {
-        if (memStream.available()) {
-          size_t read = memStream.readBytes((char*)data, len);
-          return read;
-        } else {
-          if (!async) return 0;
-          if (!queuedCommand.finished) {
-            return RESPONSE_TRY_AGAIN;
-          }
-          // We dequeue the request in onDisconnect, since we could have a disconnect in the middle of a command, which would leave the queue dangling.
-          return 0;
-        }
-      });
-      resp->setCode(async ? 200 : 400);
-      request->onDisconnect([async] () {
-        if (async) {
-          queuedCommand.queued = false;
-        }
-      });
-      request->send(resp);
+      bool parsed = commandSubmit(command);
+
+      if (queue) {
+        // Even a command that didn't parse is collected as usual, with the reason in its output
+        AsyncResponseStream* resp = request->beginResponseStream("application/json");
+        resp->setCode(202);
+        resp->addHeader("Location", String("/cmd/") + command->id);
+        resp->printf("{\"id\":%lu}", command->id);
+        request->send(resp);
+      } else {
+        sendCommandOutput(request, command, parsed ? 200 : 400);
+      }
     }
   });
 
-  server->on("^\\/display(\\/(left|right|center))?(\\/date)?(\\/ephemeral\\/([0-9]+))?(\\/)?$", HTTP_POST, [] (AsyncWebServerRequest *request) {
+  server->on("^\\/cmd\\/([0-9]+)$", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    QueuedCommand* command = commandFind(strtoul(request->pathArg(0).c_str(), NULL, 10));
+    if (!command || command->state == CommandReceiving) {
+      request->send(404, "text/plain", "No such command");
+      return;
+    }
+
+    // Output is handed out once, so polling while a command runs gets what's been written since last time
+    char output[COMMAND_OUTPUT_SIZE + 1];
+    output[command->output->readBytes(output, COMMAND_OUTPUT_SIZE)] = '\0';
+
+    StaticJsonDocument<128> doc;
+    doc["id"] = command->id;
+    doc["state"] = CommandStateStr[command->state];
+    if (command->state == CommandFinished) doc["succeeded"] = command->succeeded;
+    doc["output"] = (const char*)output;
+
+    AsyncResponseStream* resp = request->beginResponseStream("application/json");
+    serializeJson(doc, *resp);
+
+    // Collected
+    if (command->state == CommandFinished && !command->attached) commandRelease(command);
+    request->send(resp);
+  });
+
+  server->on("^\\/cmd\\/([0-9]+)\\/stream$", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    QueuedCommand* command = commandFind(strtoul(request->pathArg(0).c_str(), NULL, 10));
+    if (!command || command->state == CommandReceiving) {
+      request->send(404, "text/plain", "No such command");
+      return;
+    }
+    if (command->attached) {
+      request->send(409, "text/plain", "Already being streamed");
+      return;
+    }
+    sendCommandOutput(request, command, 200);
+  });
+
+  server->on("^\\/cmd\\/([0-9]+)$", HTTP_DELETE, [] (AsyncWebServerRequest *request) {
+    QueuedCommand* command = commandFind(strtoul(request->pathArg(0).c_str(), NULL, 10));
+    if (!command || command->state == CommandReceiving) {
+      request->send(404, "text/plain", "No such command");
+      return;
+    }
+    // A running command can't be stopped, but its result is dropped
+    commandRelease(command);
+    request->send(200, "text/plain", "Released");
+  });
+
+  server->on("^\\/display(\\/(left|right|center))?(\\/date)?(\\/ephemeral\\/([0-9]+))?(\\/(cascade|ripple|sparkle))?(\\/scroll\\/([0-9]+))?(\\/)?$", HTTP_POST, [] (AsyncWebServerRequest *request) {
     if (request->contentType() != "text/plain; ") {
       request->send(400, "text/plain", "Content type should be text/plain");
     }
   }, 
   NULL, 
   [] (AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-    static char buff[DISPLAY_MAX_CHARS+1] = {0};
-    static unsigned int buffIdx;
-    if (index == 0) buffIdx = 0;
-    unsigned int buffLen = DISPLAY_MAX_CHARS - buffIdx;
-    bool truncated = false;
-
-    if (buffLen > len) {
-      buffLen = len;
-    } else {
-      truncated = true;
+    // Checked on every part, only the first answers
+    unsigned int scroll;
+    if (!parseScroll(request->pathArg(8), &scroll)) {
+      if (index == 0) request->send(400, "text/plain", String("Scroll should be 0-") + DISPLAY_MAX_CELLS + " characters per step");
+      return;
+    }
+
+    // Long messages are written to the filesystem as they arrive, and shown from there. Clocks and scrolling
+    // messages need all their text at once, so are still truncated.
+    if (total > DISPLAY_MAX_CHARS && request->pathArg(2).isEmpty() && request->pathArg(8).isEmpty()) {
+      // Never becomes the uploader, so the rest of it is ignored
+      if (index == 0 && total > MESSAGE_MAX_SIZE) {
+        request->send(413, "text/plain", "Longer than " DEFTOLIT(MESSAGE_MAX_SIZE) " bytes");
+        return;
+      }
+
+      if (!receiveUpload(request, &storedUploader, MESSAGE_UPLOAD_PATH, "message, is the filesystem full?", data, len, index, total)) return;
+
+      displayStoredMessage(request->pathArg(4).toInt(), parseJustify(request->pathArg(1)), parseTransition(request->pathArg(6)));
+      request->send(200);
+      return;
+    }
+
+    DisplayUpload* upload = index == 0 ? displayUploadReserve(request) : displayUploadFind(request);
+    if (!upload) {
+      // Later parts of an upload that was turned away have nowhere to go
+      if (index == 0) sendBusy(request, "Too many messages arriving at once");
+      return;
     }
 
-    memcpy(&buff[index], data, buffLen);
+    // Anything past what fits is dropped, the message is still shown once it's all arrived
+    unsigned int buffLen = DISPLAY_MAX_CHARS - upload->len;
+    if (buffLen > len) buffLen = len;
+    memcpy(&upload->buff[upload->len], data, buffLen);
+    upload->len += buffLen;
 
-    if (index + len == total || truncated) {
-      DisplayJustify justify = JustifyNone;
+    if (index + len == total) {
+      DisplayJustify justify = parseJustify(request->pathArg(1));
+      DisplayTransition transition = parseTransition(request->pathArg(6));
       bool date = request->pathArg(2).length();
       int displaySec = request->pathArg(4).toInt();
-      if (!request->pathArg(1).isEmpty()) {
-        if (request->pathArg(1) == "left") {
-          justify = JustifyLeft;
-        } else if (request->pathArg(1) == "right") {
-          justify = JustifyRight;
-        } else {
-          justify = JustifyCenter;
-        }
-      }
-      buff[index+buffLen] = '\0';
-      LOGLN(String(buff) + " len " + (index+buffLen));
-      displayMessage((const char*)buff, index+buffLen, displaySec, date, justify);
-      if (truncated) {
+      upload->buff[upload->len] = '\0';
+      LOGLN(String(upload->buff) + " len " + upload->len);
+      displayMessage((const char*)upload->buff, upload->len, displaySec, date, justify, transition, scroll);
+      if (total > DISPLAY_MAX_CHARS) {
         request->send(200, "text/plain", "Truncated to " DEFTOLIT(DISPLAY_MAX_CHARS) " characters");
       } else {
         request->send(200);
       }
+      displayUploadRelease(upload);
     }
   });
 
+  server->on("/playlist", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    if (!LittleFS.exists(PLAYLIST_PATH)) {
+      request->send(404, "text/plain", "No playlist");
+      return;
+    }
+    request->send(LittleFS, PLAYLIST_PATH, "application/json");
+  });
+
+  server->on("/playlist", HTTP_DELETE, [] (AsyncWebServerRequest *request) {
+    playlistClear();
+    request->send(200);
+  });
+
+  // Written to a temporary file as it arrives, and only replaces the current playlist once it's all there and valid
+  server->on("/playlist", HTTP_POST, [] (AsyncWebServerRequest *request) {
+    if (request->contentLength() == 0) {
+      request->send(400, "text/plain", "Empty request");
+    }
+  },
+  NULL,
+  [] (AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    if (!receiveUpload(request, &playlistUploader, PLAYLIST_UPLOAD_PATH, "playlist", data, len, index, total)) return;
+
+    AsyncResponseStream* resp = request->beginResponseStream("text/plain");
+    resp->setCode(playlistReplace(PLAYLIST_UPLOAD_PATH, resp) ? 200 : 400);
+    request->send(resp);
+  });
+
+  server->on("/charmap", HTTP_GET, [] (AsyncWebServerRequest *request) {
+    if (!LittleFS.exists(CHARMAP_PATH)) {
+      request->send(404, "text/plain", "Using the built-in character map");
+      return;
+    }
+    request->send(LittleFS, CHARMAP_PATH, "text/plain; charset=utf-8");
+  });
+
+  server->on("/charmap", HTTP_DELETE, [] (AsyncWebServerRequest *request) {
+    charmapClear();
+    displayInvalidate();
+    request->send(200);
+  });
+
+  // Same as the playlist, the current map is only replaced once the new one has been uploaded and parses
+  server->on("/charmap", HTTP_POST, [] (AsyncWebServerRequest *request) {
+    if (request->contentLength() == 0) {
+      request->send(400, "text/plain", "Empty request");
+    }
+  },
+  NULL,
+  [] (AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    if (!receiveUpload(request, &charmapUploader, CHARMAP_UPLOAD_PATH, "character map", data, len, index, total)) return;
+
+    AsyncResponseStream* resp = request->beginResponseStream("text/plain");
+    if (charmapReplace(CHARMAP_UPLOAD_PATH, resp)) {
+      displayInvalidate();
+      resp->setCode(200);
+    } else {
+      resp->setCode(400);
+    }
+    request->send(resp);
+  });
+
   server->on("/update.bin", HTTP_GET, [] (AsyncWebServerRequest *request) {
-    FlashStream* sketchFlashStream = new FlashStream(0, ESP.getSketchSize());
+    FlashStream* sketchFlashStream = poolNew<FlashStream>(0, ESP.getSketchSize());
+    if (!sketchFlashStream) {
+      sendBusy(request, "Out of memory");
+      return;
+    }
     moduleContacted = true;
-    request->onDisconnect([sketchFlashStream] (void) { delete sketchFlashStream; moduleFinishedUpdate = true; });
+    request->onDisconnect([sketchFlashStream] (void) { poolDelete(sketchFlashStream); moduleFinishedUpdate = true; });
     AsyncWebServerResponse* resp = request->beginResponse(*sketchFlashStream, "application/binary", ESP.getSketchSize());
     resp->addHeader("Connection", "keep-alive");
     resp->setCode(200);
@@ -259,6 +610,9 @@ void WebServerInit() {
     }
   });
 
+  eventsInit(server);
+  assetsInit(server);
+
   server->serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
   
   server->onNotFound(notFound);
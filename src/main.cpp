@@ -12,7 +12,15 @@
 #include "Commands.h"
 #include "Communication.h"
 #include "Display.h"
+#include "Events.h"
+#include "Feed.h"
+#include "Metrics.h"
 #include "Motor.h"
+#include "Mqtt.h"
+#include "CharMap.h"
+#include "Clock.h"
+#include "Playlist.h"
+#include "TimeService.h"
 #include "WebServer.h"
 #include "Utils.h"
 
@@ -32,6 +40,17 @@ ModuleConfig Config = {
   .rpm = 15, 
   .multilineDelay = 6000,
   .timeZone = { 0 },
+  .displayRows = 0,
+  .displayCols = 0,
+  .displayLayout = { 0 },
+  .minFrameInterval = 250,
+  .distributedClock = false,
+  .motionBudget = 0,
+  .mqttHost = { 0 },
+  .mqttPort = 1883,
+  .mqttUser = { 0 },
+  .mqttPassword = { 0 },
+  .mqttTopic = "splitflap",
 };
 
 void setup() {
@@ -68,6 +87,9 @@ void setup() {
     return;
   }
 
+  // Slaves need it too, for keeping time on their own
+  charmapInit();
+
   EEPROM.begin(sizeof(ModuleConfig));
 
   // Valid saved config
@@ -141,6 +163,9 @@ void setup() {
     // Find all other devices
     enumerateModules();
 
+    // Before connecting, so SNTP starts the moment there's an address
+    timeInit();
+
     {
       WiFiManager wifiManager;
 
@@ -177,7 +202,14 @@ void setup() {
     LOGLN("Initializing web server");
     WebServerInit();
 
+    playlistInit();
+
+    mqttInit();
+
+    feedInit();
+
     MDNS.addService("http", "tcp", 80);
+    MDNS.addService(WIFI_MDNS_HOSTNAME, "udp", FEED_PORT);
     
     LOG("Found "); LOG(nKnownModules); LOGLN(" other I2C devices.");
   } else {
@@ -193,6 +225,8 @@ void setup() {
 }
 
 void loop() {
+  metricsLoop();
+
   // Handle immediate events
   if (Serial.available()) {
     char commandBuff[128];
@@ -207,10 +241,7 @@ void loop() {
     handleCommand(i2cCommand, &Serial);
   }
 
-  if (queuedCommand.queued && !queuedCommand.finished) {
-    handleCommand(queuedCommand.params); // TODO: Percolate error to caller
-    queuedCommand.finished = true; // mark as done
-  }
+  commandEvents();
 
   if (i2cOverflow) {
     deviceLastStatus = MODULE_OVERFLOW;
@@ -221,18 +252,25 @@ void loop() {
   if (motorCalibrated) {
     motorCalibrated = false;
     LOGLN("Motor is calibrated.");
+    eventsMotor("calibrated");
   }
 
   if (motorStalled) {
     motorStalled = false;
     LOGLN("Motor stalled.");
+    eventsMotor("stalled");
   }
   // ~immediate events
 
+  clockEvents();
+
   // When in master mode, we run extra services; the http server, mDNS, time, etc.
   if (Config.isMaster) {
     MDNS.update();
+    feedEvents();
     displayEvents();
+    mqttEvents();
+    eventsLoop();
   }
 
   if (shouldReboot()) {
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <string>
+
+#include <unity.h>
+
+#include "Justify.h"
+
+// Lays text out and returns it as a string, so whole pages compare at once
+static std::string layout(const char* text, DisplayJustify justify, unsigned int lineSize, unsigned int dstLen = 64, size_t* consumed = NULL) {
+  char dst[256];
+  unsigned int n = justifyText(dst, dstLen, text, strlen(text), justify, lineSize, consumed);
+  return std::string(dst, n);
+}
+
+#define ASSERT_LAYOUT(expected, actual) TEST_ASSERT_EQUAL_STRING(expected, (actual).c_str())
+
+void setUp() {}
+void tearDown() {}
+
+void test_wraps_words() {
+  ASSERT_LAYOUT("HELLO   WORLD   ", layout("HELLO WORLD", JustifyLeft, 8));
+  // Moved to the next line whole rather than split, when it fits there
+  ASSERT_LAYOUT("AB   CDEFG", layout("AB CDEFG", JustifyLeft, 5));
+}
+
+void test_collapses_spaces() {
+  ASSERT_LAYOUT("A B  ", layout("A   B", JustifyLeft, 5));
+  ASSERT_LAYOUT("AB  ", layout("  AB  ", JustifyLeft, 4));
+}
+
+void test_line_breaks() {
+  ASSERT_LAYOUT("AB  CD  ", layout("AB|CD", JustifyLeft, 4));
+  ASSERT_LAYOUT("AB      CD  ", layout("AB||CD", JustifyLeft, 4));
+  // A break right after a full line doesn't leave an empty one
+  ASSERT_LAYOUT("ABCDEF  ", layout("ABCD|EF", JustifyLeft, 4));
+}
+
+void test_center() {
+  ASSERT_LAYOUT("  AB  ", layout("AB", JustifyCenter, 6));
+  // The odd space goes on the right
+  ASSERT_LAYOUT(" ABC  ", layout("ABC", JustifyCenter, 6));
+  ASSERT_LAYOUT(" AB  CD ", layout("AB|CD", JustifyCenter, 4));
+}
+
+void test_right() {
+  ASSERT_LAYOUT("   AB", layout("AB", JustifyRight, 5));
+  ASSERT_LAYOUT("  AB CDE", layout("AB CDE", JustifyRight, 4));
+}
+
+void test_partial_last_line() {
+  // A line cut short by the end of the buffer isn't justified
+  ASSERT_LAYOUT(" AB CD", layout("AB CD", JustifyCenter, 4, 6));
+}
+
+void test_splits_long_words() {
+  ASSERT_LAYOUT("ABCDEFGHIJ  ", layout("ABCDEFGHIJ", JustifyLeft, 4));
+  ASSERT_LAYOUT("A   BCDEFG  ", layout("A BCDEFG", JustifyLeft, 4));
+}
+
+void test_none_is_verbatim() {
+  size_t consumed;
+  ASSERT_LAYOUT("A  B|C", layout("A  B|C", JustifyNone, 4, 64, &consumed));
+  TEST_ASSERT_EQUAL(6, consumed);
+  ASSERT_LAYOUT("A  B", layout("A  B|C", JustifyNone, 4, 4, &consumed));
+  TEST_ASSERT_EQUAL(4, consumed);
+}
+
+void test_consumed() {
+  const char* text = "ONE TWO THREE";
+  size_t consumed;
+
+  ASSERT_LAYOUT("ONE TWO ", layout(text, JustifyLeft, 4, 8, &consumed));
+  TEST_ASSERT_EQUAL(8, consumed);
+
+  // Carries on from there
+  ASSERT_LAYOUT("THREE   ", layout(&text[consumed], JustifyLeft, 4, 8, &consumed));
+  TEST_ASSERT_EQUAL(5, consumed);
+
+  // Everything fits
+  layout(text, JustifyLeft, 8, 64, &consumed);
+  TEST_ASSERT_EQUAL(strlen(text), consumed);
+
+  // A break that ends the page is consumed with it
+  ASSERT_LAYOUT("AB  ", layout("AB|CD", JustifyLeft, 4, 4, &consumed));
+  TEST_ASSERT_EQUAL(3, consumed);
+}
+
+void test_empty() {
+  size_t consumed = 1;
+  ASSERT_LAYOUT("", layout("", JustifyLeft, 4, 64, &consumed));
+  TEST_ASSERT_EQUAL(0, consumed);
+  ASSERT_LAYOUT("", layout("ABC", JustifyLeft, 0));
+  ASSERT_LAYOUT("", layout("   ", JustifyCenter, 4));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_wraps_words);
+  RUN_TEST(test_collapses_spaces);
+  RUN_TEST(test_line_breaks);
+  RUN_TEST(test_center);
+  RUN_TEST(test_right);
+  RUN_TEST(test_partial_last_line);
+  RUN_TEST(test_splits_long_words);
+  RUN_TEST(test_none_is_verbatim);
+  RUN_TEST(test_consumed);
+  RUN_TEST(test_empty);
+  return UNITY_END();
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <unity.h>
+
+#include "Justify.h"
+
+// Times justifyText() over growing line widths and message lengths, of words and of one long word split over
+// every line. It's a single pass over the message, so the time per character should stay about the same whatever
+// the width or length. The timings are reported, and only a cost far beyond that fails, as it would if each line
+// went back over the rest of the message.
+
+#define BENCH_CHARS 4000000 // Characters laid out for each measurement, so short messages get enough iterations
+#define BENCH_MAX_NS_PER_CHAR 200.0 // Tens of times what it takes, so a busy host doesn't fail it
+
+static const unsigned int widths[] = { 8, 16, 32, 64, 128 };
+static const unsigned int lengths[] = { 32, 128, 512, 2048, 8192, 65536 };
+
+// A single word with no spaces
+static std::vector<char> longWord(unsigned int len) {
+  std::vector<char> text(len);
+  for (unsigned int i = 0; i < len; i++) text[i] = 'A' + i % 26;
+  return text;
+}
+
+// Words of 1 to 8 letters, with the odd line break, the same every run
+static std::vector<char> message(unsigned int len) {
+  std::vector<char> text(len);
+  unsigned long seed = 1;
+  unsigned int pos = 0;
+  while (pos < len) {
+    seed = seed * 1103515245 + 12345;
+    unsigned int wordLen = 1 + (seed >> 16) % 8;
+    for (unsigned int i = 0; i < wordLen && pos < len; i++) text[pos++] = 'A' + (seed >> (i + 8)) % 26;
+    if (pos < len) text[pos++] = (seed >> 20) % 16 ? ' ' : '|';
+  }
+  return text;
+}
+
+static double nsPerChar(const std::vector<char>& text, unsigned int width) {
+  // Room for the whole message even if every word ended up on a line of its own
+  std::vector<char> dst(text.size() * width + width);
+  unsigned int iterations = BENCH_CHARS / text.size() + 1;
+  volatile unsigned int sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; i++) {
+    sink = sink + justifyText(dst.data(), dst.size(), text.data(), text.size(), JustifyCenter, width);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)iterations * text.size());
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void bench(const char* name, std::vector<char> (*generate)(unsigned int)) {
+  double slowest = 0;
+  char line[80];
+
+  for (unsigned int len : lengths) {
+    std::vector<char> text = generate(len);
+    for (unsigned int width : widths) {
+      double ns = nsPerChar(text, width);
+      if (ns > slowest) slowest = ns;
+
+      snprintf(line, sizeof(line), "%s, %5u chars, width %3u: %7.2f ns/char", name, len, width, ns);
+      TEST_MESSAGE(line);
+    }
+  }
+
+  TEST_ASSERT_TRUE_MESSAGE(slowest <= BENCH_MAX_NS_PER_CHAR, "Cost per character grows with width or length");
+}
+
+void test_words() {
+  bench("Words", message);
+}
+
+void test_long_word() {
+  bench("One word", longWord);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_words);
+  RUN_TEST(test_long_word);
+  return UNITY_END();
+}
@@ -1,8 +1,11 @@
 async function applyTilt() {
   const inputMode = document.querySelector('input[name="displayType"]:checked')
   const justifyMode = document.querySelector('input[name="justify"]:checked')
+  const transitionMode = document.querySelector('input[name="transition"]:checked')
   const ephemeral = document.getElementById('ephemeral').checked
   const ephemeralTime = Number(document.getElementById('ephemeralTime').value)
+  const scroll = document.getElementById('scroll').checked
+  const scrollStep = Number(document.getElementById('scrollStep').value)
 
   var uri = "display";
   var content = document.getElementById('customText').value
@@ -28,6 +31,22 @@ async function applyTilt() {
     uri += "/ephemeral/" + ephemeralTime
   }
 
+  switch (transitionMode.id) {
+    case "transitionCascade":
+      uri += "/cascade"
+      break
+    case "transitionRipple":
+      uri += "/ripple"
+      break
+    case "transitionSparkle":
+      uri += "/sparkle"
+      break
+  }
+
+  if (scroll) {
+    uri += "/scroll/" + scrollStep
+  }
+
   const response = await fetch(uri, {
     method: 'POST',
     headers: {